@@ -23,6 +23,10 @@
     2014/10/22: option -R to set reference binning range and output range
     2014/10/22: option -s to set reference binning range by argument
     2014/10/22: option -S to set reference binning range and output range
+    2026/10/17: bin while reading if the reference range is given
+    2026/10/17: options -k and -n to read every k-th line or a sample
+    2026/10/17: bin the series with the shared binning kernel
+    2026/10/17: minimum and maximum of the columns in one pass
 */
 
 #include <math.h>
@@ -33,11 +37,13 @@
 #include "routines/tsa.h"
 
 #define WID_STR "Averages second column with respect to binning of first column"
+#define BLOCK 1024
 
 unsigned long length=ULONG_MAX;
 unsigned long minmaxlength=3;
 unsigned long base=50;
 unsigned long exclude=0;
+unsigned long every=1,sample=0;
 unsigned int verbosity=0xff;
 char *columns=NULL;
 char my_stdout=1,gotsize=0,cropoutput=0;
@@ -45,6 +51,26 @@ char *outfile=NULL;
 char *infile=NULL;
 char *minmaxfile=NULL,*minmaxstring=NULL;
 
+/*State of the streaming mode used with a reference range*/
+struct stream {
+  unsigned long n;
+  double refmin,base,refinterval;
+  struct column_stats stats;
+  struct bin_grid *grid;
+};
+
+/*Bins one pair of values right after it was read*/
+void stream_pair(double *val,unsigned int dim,void *data)
+{
+  struct stream *s=(struct stream*)data;
+  double t;
+
+  (void)dim;
+  stats_add(&s->stats,s->n++,val[0]);
+  t=(val[0]-s->refmin)*s->base/s->refinterval;
+  bin_grid_add(s->grid,&t,val[1]);
+}
+
 void show_options(char *progname)
 {
   what_i_do(progname,WID_STR);
@@ -57,6 +83,10 @@ void show_options(char *progname)
           " first and second row.\n");
   fprintf(stderr,"\t-l length of file [default whole file]\n");
   fprintf(stderr,"\t-x # of lines to ignore [default %ld]\n",exclude);
+  fprintf(stderr,"\t-k read only every k-th line [default 1]\n");
+  fprintf(stderr,"\t-n read a random sample of # lines, of all datafiles"
+	  " together;\n\t   lines that aren't numbers are dropped from it"
+	  " [default all]\n");
   fprintf(stderr,"\t-c column selection [default 1,2]\n");
   fprintf(stderr,"\t-b # of intervals [default %ld]\n",base);
   fprintf(stderr,"\t-r minmax file to set reference range with # of intervals [optional]\n");
@@ -80,6 +110,10 @@ void scan_options(int n,char **str)
     sscanf(out,"%lu",&length);
   if ((out=check_option(str,n,'x','u')) != NULL)
     sscanf(out,"%lu",&exclude);
+  if ((out=check_option(str,n,'k','u')) != NULL)
+    sscanf(out,"%lu",&every);
+  if ((out=check_option(str,n,'n','u')) != NULL)
+    sscanf(out,"%lu",&sample);
   if ((out=check_option(str,n,'c','s')) != NULL)
     columns=out;
   if ((out=check_option(str,n,'b','u')) != NULL)
@@ -122,7 +156,12 @@ int main(int argc,char **argv)
   unsigned long offset,negoffset,range,fullrange;
   double x,size;
   double min,interval,refmin,refinterval;
-  double **series,*minmax=NULL;
+  double **series=NULL,*minmax=NULL;
+  struct moments moments;
+  struct stream stream;
+  struct bin_scale scale;
+  unsigned long n,m,bin[BLOCK];
+  long k,pos,fold;
   long *box;
   double *sum,*sumsq;
   FILE *fout,*test;
@@ -193,7 +232,19 @@ int main(int argc,char **argv)
   }
 
   /*Read data*/
-  if (columns == NULL)
+  sample_lines(every,sample);
+  if (minmaxfile != NULL || minmaxstring != NULL) {
+    /*The bins are known, so bin while reading and don't keep the data*/
+    stream.n=0;
+    stream.refmin=refmin;
+    stream.base=(double)base;
+    stream.refinterval=refinterval;
+    stream.grid=make_bin_grid(1,1);
+    length=stream_multi_series(infile,length,exclude,&dummy,
+                               (columns == NULL) ? "" : columns,(char)1,
+                               stream_pair,&stream,verbosity);
+  }
+  else if (columns == NULL)
     series=(double**)get_multi_series(infile,&length,exclude,&dummy,"",
         (char)1,verbosity);
   else
@@ -201,12 +252,12 @@ int main(int argc,char **argv)
         (char)1,verbosity);
 
   /*Get data minimum and interval*/
-  min=interval=series[0][0];
-  for (i=1;i<length;i++) {
-    if (series[0][i] < min) min=series[0][i];
-    else if (series[0][i] > interval) interval=series[0][i];
-  }
-  interval -= min;
+  if (series == NULL)
+    stats_moments(&stream.stats,length,&moments);
+  else
+    column_moments(series,1,length,&moments);
+  min=moments.min;
+  interval=moments.max-min;
 
   /*Settings*/
   if (minmaxfile != NULL || minmaxstring != NULL) {
@@ -254,16 +305,51 @@ int main(int argc,char **argv)
       sum[i]=0.0;
       sumsq[i]=0.0;
     }
-    for (i=0;i<length;i++) {
-      j=(long)((series[0][i]-refmin)*base/refinterval+offset);
-      if ((min+interval-refmin-refinterval) == 0.0) {
-        if (j == range) {
-          j=range-1;
+    if (series == NULL) {
+      /*Move the streamed bins to their place, truncation puts values
+        just below the lowest bin into it, the ones past the last bin are
+        dropped unless the maximum is the end of the reference range*/
+      k=(long)offset;
+      fold=((min+interval-refmin-refinterval) == 0.0) ? (long)range :
+        (long)range+1;
+      bin_grid_finish(stream.grid,&k,&fold);
+      for (k=stream.grid->lo[0];
+           k<stream.grid->lo[0]+(long)stream.grid->n[0];k++) {
+        pos=k-stream.grid->lo[0];
+        j=(k+(long)offset < 0) ? 0 : (unsigned long)(k+(long)offset);
+        if ((min+interval-refmin-refinterval) == 0.0) {
+          if (j == range) {
+            j=range-1;
+          }
+        }
+        if ((j >= negoffset) && (j < range)) {
+          box[j] += stream.grid->count[pos];
+          sum[j] += stream.grid->sum[pos];
+          sumsq[j] += stream.grid->sumsq[pos];
+        }
+      }
+      free_bin_grid(stream.grid);
+    }
+    else {
+      scale.min=refmin;
+      scale.base=(double)base;
+      scale.interval=refinterval;
+      scale.offset=(double)offset;
+      scale.range=range;
+      scale.edge=((min+interval-refmin-refinterval) == 0.0) ? BIN_FOLD :
+        BIN_DROP;
+      for (i=0;i<length;i+=n) {
+        n=(length-i < BLOCK) ? length-i : BLOCK;
+        bin_indices(series[0]+i,n,&scale,bin);
+        for (m=0;m<n;m++) {
+          j=bin[m];
+          if (j == range)
+            continue;
+          box[j]++;
+          sum[j]+=series[1][i+m];
+          sumsq[j]+=pow(series[1][i+m],2);
         }
       }
-      box[j]++;
-      sum[j]+=series[1][i];
-      sumsq[j]+=pow(series[1][i],2);
     }
   }
 
@@ -1,6 +1,9 @@
 /*Author: Rainer Hegger. Last modified: May 20, 2014 */
 /*Changes by Bjoern Bastian:
     2014/09/29: fork for binning instead of histogram creation
+    2026/10/17: bin while reading if the reference range is given
+    2026/10/17: options -k and -n to read every k-th line or a sample
+    2026/10/17: minimum and maximum of the columns in one pass
 */
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,6 +20,7 @@
 unsigned long length=ULONG_MAX;
 unsigned long minmaxlength=3;
 unsigned long exclude=0;
+unsigned long every=1,sample=0;
 char *columns=NULL;
 unsigned int base=32;
 unsigned int verbosity=0xff;
@@ -25,6 +29,30 @@ char *outfile=NULL;
 char *infile=NULL;
 char *minmaxfile=NULL;
 
+/*State of the streaming mode used with a reference range*/
+struct stream {
+  unsigned long n;
+  double refmin[2],base,refinterval[2];
+  struct column_stats stats[2];
+  struct bin_grid *grid;
+};
+
+/*Bins one row right after it was read*/
+void stream_row(double *val,unsigned int dim,void *data)
+{
+  struct stream *s=(struct stream*)data;
+  double t[2];
+  unsigned int d;
+
+  (void)dim;
+  for (d=0;d<2;d++) {
+    stats_add(&s->stats[d],s->n,val[d]);
+    t[d]=(val[d]-s->refmin[d])*s->base/s->refinterval[d];
+  }
+  s->n++;
+  bin_grid_add(s->grid,t,val[2]);
+}
+
 void show_options(char *progname)
 {
   what_i_do(progname,WID_STR);
@@ -35,6 +63,10 @@ void show_options(char *progname)
           " Just - also means stdin\n");
   fprintf(stderr,"\t-l length of file [default whole file]\n");
   fprintf(stderr,"\t-x # of lines to ignore [default %ld]\n",exclude);
+  fprintf(stderr,"\t-k read only every k-th line [default 1]\n");
+  fprintf(stderr,"\t-n read a random sample of # lines, of all datafiles"
+	  " together;\n\t   lines that aren't numbers are dropped from it"
+	  " [default all]\n");
   fprintf(stderr,"\t-c columns to read [default 1,2,3]\n");
   fprintf(stderr,"\t-b # of intervals per dim [default %u]\n",base);
   fprintf(stderr,"\t-r reference file for binning range [optional]\n");
@@ -55,6 +87,10 @@ void scan_options(int n,char **argv)
     sscanf(out,"%lu",&length);
   if ((out=check_option(argv,n,'x','u')) != NULL)
     sscanf(out,"%lu",&exclude);
+  if ((out=check_option(argv,n,'k','u')) != NULL)
+    sscanf(out,"%lu",&every);
+  if ((out=check_option(argv,n,'n','u')) != NULL)
+    sscanf(out,"%lu",&sample);
   if ((out=check_option(argv,n,'c','s')) != NULL)
     columns=out;
   if ((out=check_option(argv,n,'b','u')) != NULL)
@@ -79,9 +115,12 @@ int main(int argc,char **argv)
   char stdi=0;
   double base_1,sx,sy;
   double min[2],interval[2],refmin[2],refinterval[2];
-  double **series,**minmax;
+  double **series=NULL,**minmax;
+  struct moments moments[2];
+  struct stream stream;
   unsigned long i,j,N;
   unsigned int bi,bj;
+  long k[2],pos,fold[2];
   unsigned long **box;
   double **sum,**sumsq;
   FILE *fout=NULL,*test=NULL;
@@ -127,6 +166,7 @@ int main(int argc,char **argv)
   }
 
   /*Read data*/
+  sample_lines(every,sample);
   infile=search_datafile(argc,argv,NULL,verbosity);
   if (infile == NULL)
     stdi=1;
@@ -142,7 +182,20 @@ int main(int argc,char **argv)
     }
   }
 
-  if (columns == NULL)
+  if (minmaxfile != NULL) {
+    /*The bins are known, so bin while reading and don't keep the data*/
+    stream.n=0;
+    stream.base=(double)base;
+    for (j=0;j<2;j++) {
+      stream.refmin[j]=refmin[j];
+      stream.refinterval[j]=refinterval[j];
+    }
+    stream.grid=make_bin_grid(2,1);
+    length=stream_multi_series(infile,length,exclude,&dim,
+                               (columns == NULL) ? "" : columns,1,
+                               stream_row,&stream,verbosity);
+  }
+  else if (columns == NULL)
     series=(double**)get_multi_series(infile,&length,exclude,&dim,"",1,
                                       verbosity);
   else
@@ -150,16 +203,14 @@ int main(int argc,char **argv)
                                       1,verbosity);
 
   /*Get data minima and intervals*/
-  min[0]=interval[0]=series[0][0];
-  min[1]=interval[1]=series[1][0];
-  for (i=1;i<length;i++) {
-    if (series[0][i] < min[0]) min[0]=series[0][i];
-    else if (series[0][i] > interval[0]) interval[0]=series[0][i];
-    if (series[1][i] < min[1]) min[1]=series[1][i];
-    else if (series[1][i] > interval[1]) interval[1]=series[1][i];
+  if (series != NULL)
+    column_moments(series,2,length,moments);
+  for (j=0;j<2;j++) {
+    if (series == NULL)
+      stats_moments(&stream.stats[j],length,&moments[j]);
+    min[j]=moments[j].min;
+    interval[j]=moments[j].max-min[j];
   }
-  interval[0] -= min[0];
-  interval[1] -= min[1];
 
   /*Settings*/
   base_1=(double)base;
@@ -215,14 +266,43 @@ int main(int argc,char **argv)
     }
   }
 
-  for (i=0;i<length;i++) {
-    bi=(unsigned int)((series[0][i]-refmin[0])*base_1/refinterval[0]+offset[0]);
-    bj=(unsigned int)((series[1][i]-refmin[1])*base_1/refinterval[1]+offset[1]);
-    bi=(bi>=range[0])? range[0]-1:bi;
-    bj=(bj>=range[1])? range[1]-1:bj;
-    box[bi][bj]++;
-    sum[bi][bj]+=series[2][i];
-    sumsq[bi][bj]+=pow(series[2][i],2);
+  if (series == NULL) {
+    /*Move the streamed bins to their place, truncation puts values
+      just below the lowest bin into it*/
+    k[0]=(long)offset[0];
+    k[1]=(long)offset[1];
+    fold[0]=(long)range[0];
+    fold[1]=(long)range[1];
+    bin_grid_finish(stream.grid,k,fold);
+    for (k[0]=stream.grid->lo[0];
+         k[0]<stream.grid->lo[0]+(long)stream.grid->n[0];k[0]++)
+      for (k[1]=stream.grid->lo[1];
+           k[1]<stream.grid->lo[1]+(long)stream.grid->n[1];k[1]++) {
+        pos=bin_grid_index(stream.grid,k);
+        if (stream.grid->count[pos] == 0)
+          continue;
+        bi=(k[0]+(long)offset[0] < 0) ? 0 : (unsigned int)(k[0]+offset[0]);
+        bj=(k[1]+(long)offset[1] < 0) ? 0 : (unsigned int)(k[1]+offset[1]);
+        bi=(bi>=range[0])? range[0]-1:bi;
+        bj=(bj>=range[1])? range[1]-1:bj;
+        box[bi][bj] += stream.grid->count[pos];
+        sum[bi][bj] += stream.grid->sum[pos];
+        sumsq[bi][bj] += stream.grid->sumsq[pos];
+      }
+    free_bin_grid(stream.grid);
+  }
+  else {
+    for (i=0;i<length;i++) {
+      bi=(unsigned int)((series[0][i]-refmin[0])*base_1/refinterval[0]
+                        +offset[0]);
+      bj=(unsigned int)((series[1][i]-refmin[1])*base_1/refinterval[1]
+                        +offset[1]);
+      bi=(bi>=range[0])? range[0]-1:bi;
+      bj=(bj>=range[1])? range[1]-1:bj;
+      box[bi][bj]++;
+      sum[bi][bj]+=series[2][i];
+      sumsq[bi][bj]+=pow(series[2][i],2);
+    }
   }
 
   if (!stout)
@@ -298,14 +378,10 @@ int main(int argc,char **argv)
   free(box);
   free(sum);
   free(sumsq);
-  free(series[0]);
-  free(series[1]);
-  free(series);
-  if (minmaxfile != NULL) {
-    free(minmax[0]);
-    free(minmax[1]);
-    free(minmax);
-  }
+  if (series != NULL)
+    free_multi_series(series,dim);
+  if (minmaxfile != NULL)
+    free_multi_series(minmax,dim);
 
   return 0;
 }
@@ -2,6 +2,11 @@
 /*Changes by Bjoern Bastian:
     2014/05/21: option -r to set reference binning range
     2014/07/07: option -F for relative frequencies
+    2026/10/17: bin while reading if the reference range is given
+    2026/10/17: options -k and -n to read every k-th line or a sample
+    2026/10/17: option -B to make one histogram for each datafile
+    2026/10/17: bin on all processors
+    2026/10/17: minimum and maximum of the columns in one pass
 */
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,17 +20,69 @@
 
 #define WID_STR "Creates a 2d-histogram of an bivariate time series [2014/07/07: option -F added]"
 
-unsigned long length=ULONG_MAX;
+unsigned long maxlength=ULONG_MAX;
 unsigned long minmaxlength=3;
 unsigned long exclude=0;
+unsigned long every=1,sample=0;
 char *column=NULL;
 unsigned int base=16;
 unsigned int verbosity=0xff;
 unsigned int stout=1;
-char density=1;
+char density=1,batch=0;
 char *outfile=NULL;
 char *infile=NULL;
 char *minmaxfile=NULL;
+double **minmax=NULL;
+
+/*State of the streaming mode used with a reference range*/
+struct stream {
+  unsigned long n;
+  double refmin[2],base,refinterval[2];
+  struct column_stats stats[2];
+  struct bin_grid *grid;
+};
+
+/*Bins one pair of values right after it was read*/
+void stream_pair(double *val,unsigned int dim,void *data)
+{
+  struct stream *s=(struct stream*)data;
+  double t[2];
+  unsigned int d;
+
+  (void)dim;
+  for (d=0;d<2;d++) {
+    stats_add(&s->stats[d],s->n,val[d]);
+    t[d]=(val[d]-s->refmin[d])*s->base/s->refinterval[d];
+  }
+  s->n++;
+  bin_grid_add(s->grid,t,0.0);
+}
+
+/*What bin_pairs needs, the bins are box[i][j] at i*range[1]+j followed by
+  box1d*/
+struct pairs {
+  double **series,*refmin,*refinterval,base_1;
+  unsigned long *offset,*range;
+};
+
+/*Bins the pairs first..last-1 of the series*/
+void bin_pairs(unsigned long first,unsigned long last,long *box,void *data)
+{
+  struct pairs *p=(struct pairs*)data;
+  unsigned long i,*range=p->range;
+  unsigned int bi,bj;
+
+  for (i=first;i<last;i++) {
+    bi=(unsigned int)((p->series[0][i]-p->refmin[0])*p->base_1/
+                      p->refinterval[0]+p->offset[0]);
+    bj=(unsigned int)((p->series[1][i]-p->refmin[1])*p->base_1/
+                      p->refinterval[1]+p->offset[1]);
+    bi=(bi>=range[0])? range[0]-1:bi;
+    bj=(bj>=range[1])? range[1]-1:bj;
+    box[bi*range[1]+bj]++;
+    box[range[0]*range[1]+bi]++;
+  }
+}
 
 void show_options(char *progname)
 {
@@ -37,6 +94,10 @@ void show_options(char *progname)
           " Just - also means stdin\n");
   fprintf(stderr,"\t-l length of file [default whole file]\n");
   fprintf(stderr,"\t-x # of lines to ignore [default %ld]\n",exclude);
+  fprintf(stderr,"\t-k read only every k-th line [default 1]\n");
+  fprintf(stderr,"\t-n read a random sample of # lines, of all datafiles"
+	  " together;\n\t   lines that aren't numbers are dropped from it"
+	  " [default all]\n");
   fprintf(stderr,"\t-c columns to read [default 1,2]\n");
   fprintf(stderr,"\t-b # of intervals per dim [default %u]\n",base);
   fprintf(stderr,"\t-F output relative frequencies not densities"
@@ -44,6 +105,8 @@ void show_options(char *progname)
   fprintf(stderr,"\t-r reference file for binning range [optional]\n");
   fprintf(stderr,"\t-o output file [default 'datafile'.his ;"
           " If no -o is given: stdout]\n");
+  fprintf(stderr,"\t-B write a histogram 'datafile'.his for each datafile,"
+          " several at a time\n\t   [default not set]\n");
   fprintf(stderr,"\t-V verbosity level [default 1]\n\t\t"
           "0='only panic messages'\n\t\t"
           "1='+ input/output messages'\n");
@@ -56,9 +119,13 @@ void scan_options(int n,char **argv)
   char *out;
 
   if ((out=check_option(argv,n,'l','u')) != NULL)
-    sscanf(out,"%lu",&length);
+    sscanf(out,"%lu",&maxlength);
   if ((out=check_option(argv,n,'x','u')) != NULL)
     sscanf(out,"%lu",&exclude);
+  if ((out=check_option(argv,n,'k','u')) != NULL)
+    sscanf(out,"%lu",&every);
+  if ((out=check_option(argv,n,'n','u')) != NULL)
+    sscanf(out,"%lu",&sample);
   if ((out=check_option(argv,n,'c','s')) != NULL)
     column=out;
   if ((out=check_option(argv,n,'b','u')) != NULL)
@@ -67,6 +134,8 @@ void scan_options(int n,char **argv)
     sscanf(out,"%u",&verbosity);
   if ((out=check_option(argv,n,'F','n')) != NULL)
     density=0;
+  if ((out=check_option(argv,n,'B','n')) != NULL)
+    batch=1;
   if ((out=check_option(argv,n,'r','o')) != NULL) {
     if (strlen(out) > 0)
       minmaxfile=out;
@@ -78,93 +147,69 @@ void scan_options(int n,char **argv)
   }
 }
 
-int main(int argc,char **argv)
+/*Makes the histogram of one datafile, NULL for stdin*/
+void make_histogram(char *infile,char *outfile)
 {
   unsigned int dim=2;
   unsigned long offset[2],negoffset[2],range[2];
-  char stdi=0;
   double base_1,sx,sy,logmax,logout,norm1,norm2;
   double min[2],interval[2],refmin[2],refinterval[2];
-  double **series,**minmax;
-  unsigned long i,j,lmax;
+  double **series=NULL;
+  struct moments moments[2];
+  struct stream stream;
+  struct pairs pairs;
+  unsigned long i,j,lmax,length=maxlength;
   unsigned int bi,bj;
-  unsigned long **box,*box1d;
-  FILE *fout=NULL,*test=NULL;
-
-  if (scan_help(argc,argv))
-    show_options(argv[0]);
+  long k[2],pos;
+  unsigned long **box,*box1d,*cells;
+  FILE *fout=NULL;
 
-  scan_options(argc,argv);
-#ifndef OMIT_WHAT_I_DO
-  if (verbosity&VER_INPUT)
-    what_i_do(argv[0],WID_STR);
-#endif
-
-  /*Get reference range for option '-r'*/
-  if (minmaxfile != NULL) {
-    test=fopen(minmaxfile,"r");
-    if (test == NULL) {
-      fprintf(stderr,"File %s not found!\n",minmaxfile);
-      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
-    }
-    if (verbosity&VER_INPUT) {
-      fprintf(stderr,"Get reference range from file %s\n",minmaxfile);
-    }
-
-    if (column == NULL) {
-      minmax=(double**)get_multi_series(minmaxfile,&minmaxlength,0,&dim,"",1,
-                                        verbosity);
-    }
-    else {
-      minmax=(double**)get_multi_series(minmaxfile,&minmaxlength,0,&dim,column,
-                                        1,verbosity);
-    }
-
-    if(minmaxlength!=2) {
-      fprintf(stderr,"Wrong format in file '%s'. Needs exactly two lines"
-          " with minima and maxima for each column.\n",minmaxfile);
-      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
-    }
+  if (!stout && !test_outfile(outfile))
+    return;
+  if (minmax != NULL) {
     refmin[0]=minmax[0][0];
     refinterval[0]=minmax[0][1]-refmin[0];
     refmin[1]=minmax[1][0];
     refinterval[1]=minmax[1][1]-refmin[1];
   }
 
-  /*Read data*/
-  infile=search_datafile(argc,argv,NULL,verbosity);
-  if (infile == NULL)
-    stdi=1;
-
-  if (!stout && (outfile == NULL)) {
-    if (!stdi) {
-      check_alloc(outfile=calloc(strlen(infile)+5,(size_t)1));
-      sprintf(outfile,"%s.his",infile);
-    }
-    else {
-      check_alloc(outfile=calloc((size_t)10,(size_t)1));
-      sprintf(outfile,"stdin.his");
+  if (minmaxfile != NULL) {
+    /*The bins are known, so bin while reading and don't keep the data*/
+    stream.n=0;
+    stream.base=(double)base;
+    for (j=0;j<2;j++) {
+      stream.refmin[j]=refmin[j];
+      stream.refinterval[j]=refinterval[j];
     }
+    stream.grid=make_bin_grid(2,0);
+    length=stream_multi_series(infile,length,exclude,&dim,
+                               (column == NULL) ? "" : column,1,
+                               stream_pair,&stream,verbosity);
   }
-
-  if (column == NULL)
+  else if (column == NULL)
     series=(double**)get_multi_series(infile,&length,exclude,&dim,"",1,
                                       verbosity);
   else
     series=(double**)get_multi_series(infile,&length,exclude,&dim,column,
                                       1,verbosity);
+  /*A file of a batch without lines is skipped*/
+  if (length == 0) {
+    if (series == NULL)
+      free_bin_grid(stream.grid);
+    else
+      free_multi_series(series,dim);
+    return;
+  }
 
   /*Get data minima and intervals*/
-  min[0]=interval[0]=series[0][0];
-  min[1]=interval[1]=series[1][0];
-  for (i=1;i<length;i++) {
-    if (series[0][i] < min[0]) min[0]=series[0][i];
-    else if (series[0][i] > interval[0]) interval[0]=series[0][i];
-    if (series[1][i] < min[1]) min[1]=series[1][i];
-    else if (series[1][i] > interval[1]) interval[1]=series[1][i];
+  if (series != NULL)
+    column_moments(series,2,length,moments);
+  for (j=0;j<2;j++) {
+    if (series == NULL)
+      stats_moments(&stream.stats[j],length,&moments[j]);
+    min[j]=moments[j].min;
+    interval[j]=moments[j].max-min[j];
   }
-  interval[0] -= min[0];
-  interval[1] -= min[1];
 
   /*Settings*/
   base_1=(double)base;
@@ -205,17 +250,16 @@ int main(int argc,char **argv)
     range[1]=base;
   }
 
-  /*Binning*/
-  check_alloc(box1d=(unsigned long*)malloc(sizeof(unsigned long)*range[0]));
-  for (i=negoffset[0];i<range[0];i++)
-    box1d[i]=1;
+  /*Binning, all bins in one block for bin_pairs*/
+  check_alloc(cells=(unsigned long*)malloc(sizeof(unsigned long)*
+                                           range[0]*(range[1]+1)));
+  for (i=0;i<range[0]*(range[1]+1);i++)
+    cells[i]=1;
+  box1d=cells+range[0]*range[1];
 
   check_alloc(box=(unsigned long**)malloc(sizeof(unsigned long*)*range[0]));
-  for (i=negoffset[0];i<range[0];i++) {
-    check_alloc(box[i]=(unsigned long*)malloc(sizeof(unsigned long)*range[1]));
-    for (j=negoffset[1];j<range[1];j++)
-      box[i][j]=1;
-  }
+  for (i=0;i<range[0];i++)
+    box[i]=cells+i*range[1];
   if (density) {
     norm1=(double)(length+(range[0]-negoffset[0]))*sx;
     norm2=(double)(length+(range[0]-negoffset[0])*(range[1]-negoffset[1]))*sx*sy;
@@ -225,13 +269,37 @@ int main(int argc,char **argv)
     norm2=(double)(length+(range[0]-negoffset[0])*(range[1]-negoffset[1]));
   }
 
-  for (i=0;i<length;i++) {
-    bi=(unsigned int)((series[0][i]-refmin[0])*base_1/refinterval[0]+offset[0]);
-    bj=(unsigned int)((series[1][i]-refmin[1])*base_1/refinterval[1]+offset[1]);
-    bi=(bi>=range[0])? range[0]-1:bi;
-    bj=(bj>=range[1])? range[1]-1:bj;
-    box[bi][bj]++;
-    box1d[bi]++;
+  if (series == NULL) {
+    /*Move the streamed bins to their place, truncation puts values
+      just below the lowest bin into it*/
+    k[0]=(long)offset[0];
+    k[1]=(long)offset[1];
+    bin_grid_finish(stream.grid,k,NULL);
+    for (k[0]=stream.grid->lo[0];
+         k[0]<stream.grid->lo[0]+(long)stream.grid->n[0];k[0]++)
+      for (k[1]=stream.grid->lo[1];
+           k[1]<stream.grid->lo[1]+(long)stream.grid->n[1];k[1]++) {
+        pos=bin_grid_index(stream.grid,k);
+        if (stream.grid->count[pos] == 0)
+          continue;
+        bi=(k[0]+(long)offset[0] < 0) ? 0 : (unsigned int)(k[0]+offset[0]);
+        bj=(k[1]+(long)offset[1] < 0) ? 0 : (unsigned int)(k[1]+offset[1]);
+        bi=(bi>=range[0])? range[0]-1:bi;
+        bj=(bj>=range[1])? range[1]-1:bj;
+        box[bi][bj] += stream.grid->count[pos];
+        box1d[bi] += stream.grid->count[pos];
+      }
+    free_bin_grid(stream.grid);
+  }
+  else {
+    pairs.series=series;
+    pairs.refmin=refmin;
+    pairs.refinterval=refinterval;
+    pairs.base_1=base_1;
+    pairs.offset=offset;
+    pairs.range=range;
+    parallel_bins(length,range[0]*(range[1]+1),bin_pairs,&pairs,
+                  (long*)cells);
   }
 
   lmax=0;
@@ -241,9 +309,6 @@ int main(int argc,char **argv)
         lmax=(box[i][j]>lmax)? box[i][j]:lmax;
   logmax=log((double)lmax/norm2);
 
-  if (!stout)
-    test_outfile(outfile);
-
   fout=fopen(outfile,"w");
 
   for (i=negoffset[0];i<range[0];i++) {
@@ -270,23 +335,102 @@ int main(int argc,char **argv)
   if (!stout)
     fclose(fout);
 
+  free(cells);
+  free(box);
+  if (series != NULL)
+    free_multi_series(series,dim);
+}
+
+/*Option -B, one histogram for each datafile*/
+void batch_histogram(char *name,void *data)
+{
+  char *out;
+
+  (void)data;
+  check_alloc(out=calloc(strlen(name)+5,(size_t)1));
+  sprintf(out,"%s.his",name);
+  make_histogram(name,out);
+  free(out);
+}
+
+int main(int argc,char **argv)
+{
+  unsigned int dim=2,nfiles=0;
+  char stdi=0,**files=NULL;
+  FILE *test=NULL;
+
+  if (scan_help(argc,argv))
+    show_options(argv[0]);
+
+  scan_options(argc,argv);
+#ifndef OMIT_WHAT_I_DO
+  if (verbosity&VER_INPUT)
+    what_i_do(argv[0],WID_STR);
+#endif
+
+  /*Get reference range for option '-r'*/
+  if (minmaxfile != NULL) {
+    test=fopen(minmaxfile,"r");
+    if (test == NULL) {
+      fprintf(stderr,"File %s not found!\n",minmaxfile);
+      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
+    }
+    if (verbosity&VER_INPUT) {
+      fprintf(stderr,"Get reference range from file %s\n",minmaxfile);
+    }
+
+    if (column == NULL) {
+      minmax=(double**)get_multi_series(minmaxfile,&minmaxlength,0,&dim,"",1,
+                                        verbosity);
+    }
+    else {
+      minmax=(double**)get_multi_series(minmaxfile,&minmaxlength,0,&dim,column,
+                                        1,verbosity);
+    }
+
+    if(minmaxlength!=2) {
+      fprintf(stderr,"Wrong format in file '%s'. Needs exactly two lines"
+          " with minima and maxima for each column.\n",minmaxfile);
+      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
+    }
+  }
+
+  /*Read data*/
+  sample_lines(every,sample);
+  if (batch)
+    files=search_datafiles(argc,argv,NULL,verbosity,&nfiles);
+  else
+    infile=search_datafile(argc,argv,NULL,verbosity);
+  if ((infile == NULL) && (files == NULL))
+    stdi=1;
+
+  if (files != NULL) {
+    /*Every file is written to its own output, several at a time*/
+    stout=0;
+    run_batch(nfiles,files,batch_histogram,NULL);
+    free(files);
+  }
+  else {
+    if (!stout && (outfile == NULL)) {
+      if (!stdi) {
+        check_alloc(outfile=calloc(strlen(infile)+5,(size_t)1));
+        sprintf(outfile,"%s.his",infile);
+      }
+      else {
+        check_alloc(outfile=calloc((size_t)10,(size_t)1));
+        sprintf(outfile,"stdin.his");
+      }
+    }
+    make_histogram(infile,outfile);
+  }
+
   /*Freeing all allocated arrays*/
   if (outfile != NULL) free(outfile);
   if (infile != NULL) free(infile);
   if (minmaxfile != NULL) free(minmaxfile);
   if (column != NULL) free(column);
-  free(box1d);
-  for (i=negoffset[0];i<range[0];i++)
-    free(box[i]);
-  free(box);
-  free(series[0]);
-  free(series[1]);
-  free(series);
-  if (minmaxfile != NULL) {
-    free(minmax[0]);
-    free(minmax[1]);
-    free(minmax);
-  }
+  if (minmaxfile != NULL)
+    free_multi_series(minmax,dim);
 
   return 0;
 }
@@ -23,6 +23,14 @@
     2014/10/21: option -R to set reference binning range and output range
     2014/10/21: option -s to set reference binning range by argument
     2014/10/21: option -S to set reference binning range and output range
+    2026/10/17: bin while reading if the reference range is given
+    2026/10/17: option -L to read the data twice instead of keeping them
+    2026/10/17: option -W to bin in one pass with a range that doubles
+    2026/10/17: options -k and -n to read every k-th line or a sample
+    2026/10/17: option -B to make one histogram for each datafile
+    2026/10/17: bin the series with the shared binning kernel
+    2026/10/17: bin on all processors
+    2026/10/17: minimum, maximum and variance in one pass
 */
 
 #include <math.h>
@@ -34,16 +42,78 @@
 
 #define WID_STR "Creates a histogram of a onedimensional dataset [2014/05/16: option -r added]"
 
-unsigned long length=ULONG_MAX;
+unsigned long maxlength=ULONG_MAX;
 unsigned long minmaxlength=3;
 unsigned long base=50;
 unsigned long exclude=0;
+unsigned long every=1,sample=0;
 unsigned int column=1;
 unsigned int verbosity=0xff;
-char my_stdout=1,gotsize=0,density=0,counts=0,cropoutput=0;
+char my_stdout=1,gotsize=0,density=0,counts=0,cropoutput=0,lowmem=0;
+char widen=0,batch=0;
 char *outfile=NULL;
 char *infile=NULL;
 char *minmaxfile=NULL,*minmaxstring=NULL;
+double *minmax=NULL;
+
+/*State of the streaming modes*/
+struct stream {
+  unsigned long n;
+  double refmin,base,refinterval;
+  struct column_stats stats;
+  struct bin_grid *grid;
+  struct doubling_bins *bins;
+  unsigned long notfinite;
+  long *box;
+  unsigned long offset,range;
+  char fold;
+};
+
+/*Bins one value right after it was read and keeps the statistics
+  in the same order as the loops over the whole series do*/
+void stream_value(double *val,unsigned int dim,void *data)
+{
+  struct stream *s=(struct stream*)data;
+  double x=val[0],t;
+
+  (void)dim;
+  stats_add(&s->stats,s->n++,x);
+  t=(x-s->refmin)*s->base/s->refinterval;
+  bin_grid_add(s->grid,&t,0.0);
+}
+
+/*Option -W, bins each value as it comes and widens the range if needed*/
+void widen_value(double *val,unsigned int dim,void *data)
+{
+  struct stream *s=(struct stream*)data;
+
+  (void)dim;
+  stats_add(&s->stats,s->n++,val[0]);
+  if (!doubling_bins_add(s->bins,val[0]))
+    s->notfinite++;
+}
+
+/*First pass of option -L, only the statistics*/
+void stream_stats(double *val,unsigned int dim,void *data)
+{
+  struct stream *s=(struct stream*)data;
+
+  (void)dim;
+  stats_add(&s->stats,s->n++,val[0]);
+}
+
+/*Second pass of option -L, bins exactly like the loop over the series*/
+void bin_value(double *val,unsigned int dim,void *data)
+{
+  struct stream *s=(struct stream*)data;
+  unsigned long j;
+
+  (void)dim;
+  j=(long)((val[0]-s->refmin)*s->base/s->refinterval+s->offset);
+  if (s->fold && (j == s->range))
+    j=s->range-1;
+  s->box[j]++;
+}
 
 void show_options(char *progname)
 {
@@ -57,6 +127,10 @@ void show_options(char *progname)
           " first and second row.\n");
   fprintf(stderr,"\t-l length of file [default whole file]\n");
   fprintf(stderr,"\t-x # of lines to ignore [default %ld]\n",exclude);
+  fprintf(stderr,"\t-k read only every k-th line [default 1]\n");
+  fprintf(stderr,"\t-n read a random sample of # lines, of all datafiles"
+	  " together;\n\t   lines that aren't numbers are dropped from it"
+	  " [default all]\n");
   fprintf(stderr,"\t-c column to read [default %d]\n",column);
   fprintf(stderr,"\t-b # of intervals [default %ld]\n",base);
   fprintf(stderr,"\t-D output densities not relative frequencies"
@@ -67,8 +141,14 @@ void show_options(char *progname)
   fprintf(stderr,"\t-R minmax file to set reference range and resctrict output [optional]\n");
   fprintf(stderr,"\t-s num,num to set reference range with # of intervals [optional]\n");
   fprintf(stderr,"\t-S num,num to set reference range and resctrict output [optional]\n");
+  fprintf(stderr,"\t-L read the data twice instead of keeping them in"
+          " memory [default not set]\n");
+  fprintf(stderr,"\t-W bin in one pass, doubling the range whenever a value"
+          " falls outside\n\t   [default not set]\n");
   fprintf(stderr,"\t-o output file [default 'datafile'.his ;"
 	  " If no -o is given: stdout]\n");
+  fprintf(stderr,"\t-B write a histogram 'datafile'.his for each datafile,"
+          " several at a time\n\t   [default not set]\n");
   fprintf(stderr,"\t-V verbosity level [default 1]\n\t\t"
           "0='only panic messages'\n\t\t"
           "1='+ input/output messages'\n");
@@ -81,9 +161,13 @@ void scan_options(int n,char **str)
   char *out;
 
   if ((out=check_option(str,n,'l','u')) != NULL)
-    sscanf(out,"%lu",&length);
+    sscanf(out,"%lu",&maxlength);
   if ((out=check_option(str,n,'x','u')) != NULL)
     sscanf(out,"%lu",&exclude);
+  if ((out=check_option(str,n,'k','u')) != NULL)
+    sscanf(out,"%lu",&every);
+  if ((out=check_option(str,n,'n','u')) != NULL)
+    sscanf(out,"%lu",&sample);
   if ((out=check_option(str,n,'c','u')) != NULL)
     sscanf(out,"%u",&column);
   if ((out=check_option(str,n,'b','u')) != NULL)
@@ -94,6 +178,12 @@ void scan_options(int n,char **str)
     density=1;
   if ((out=check_option(str,n,'C','n')) != NULL)
     counts=1;
+  if ((out=check_option(str,n,'L','n')) != NULL)
+    lowmem=1;
+  if ((out=check_option(str,n,'W','n')) != NULL)
+    widen=1;
+  if ((out=check_option(str,n,'B','n')) != NULL)
+    batch=1;
   if ((out=check_option(str,n,'r','o')) != NULL) {
     if (strlen(out) > 0)
       minmaxfile=out;
@@ -121,88 +211,80 @@ void scan_options(int n,char **str)
   }
 }
 
-int main(int argc,char **argv)
+/*Makes the histogram of one datafile, NULL for stdin*/
+void make_histogram(char *infile,char *outfile)
 {
-  char stdi=0;
-  unsigned long i,j;
+  unsigned long i,j,length=maxlength;
   unsigned long offset,negoffset,range,fullrange;
+  long k;
   double x,norm,size;
-  double min,interval,refmin,refinterval;
-  double *series,*minmax=NULL;
+  double min,interval,refmin=0.0,refinterval=0.0;
+  double *series=NULL;
   double average,var;
+  struct moments moments;
+  struct stream stream;
+  struct second_pass *again=NULL;
+  struct bin_scale scale;
   long *box;
-  FILE *fout,*test;
-
-  if (scan_help(argc,argv))
-    show_options(argv[0]);
-  
-  scan_options(argc,argv);
-#ifndef OMIT_WHAT_I_DO
-  if (verbosity&VER_INPUT)
-    what_i_do(argv[0],WID_STR);
-#endif
-
-  infile=search_datafile(argc,argv,&column,verbosity);
-  if (infile == NULL)
-    stdi=1;
-
-  if (outfile == NULL) {
-    if (!stdi) {
-      check_alloc(outfile=(char*)calloc(strlen(infile)+5,1));
-      strcpy(outfile,infile);
-      strcat(outfile,".his");
-    }
-    else {
-      check_alloc(outfile=(char*)calloc((size_t)10,1));
-      strcpy(outfile,"stdin.his");
-    }
-  }
-  if (!my_stdout)
-    test_outfile(outfile);
+  FILE *fout;
 
-  /*Get reference range for options '-r' and '-R'*/
-  if (minmaxfile != NULL) {
-    test=fopen(minmaxfile,"r");
-    if (test == NULL) {
-      fprintf(stderr,"File %s not found!\n",minmaxfile);
-      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
-    }
-    if (verbosity&VER_INPUT) {
-      fprintf(stderr,"Get reference range from %s, reading column %u\n",
-          minmaxfile,column);
-    }
-
-    minmax=(double*)get_series(minmaxfile,&minmaxlength,0,column,verbosity);
-    if (minmaxlength != 2) {
-      fprintf(stderr,"Wrong format in file '%s'. Needs exactly two lines"
-          " with minima and maxima for each column.\n",minmaxfile);
-      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
-    }
+  if (minmax != NULL) {
     refmin=minmax[0];
     refinterval=minmax[1]-refmin;
   }
 
-  /*Get reference range for options '-s' and '-S'*/
-  if (minmaxstring != NULL) {
-    if (minmax == NULL) {
-      check_alloc(minmax=(double*)malloc(sizeof(double)*2));
-    }
-    sscanf(minmaxstring,"%lf,%lf",&minmax[0],&minmax[1]);
-    refmin=minmax[0];
-    refinterval=minmax[1]-refmin;
+  /*Read data*/
+  if (minmaxfile != NULL || minmaxstring != NULL) {
+    /*The bins are known, so bin while reading and don't keep the data*/
+    stream.n=0;
+    stream.refmin=refmin;
+    stream.base=(double)base;
+    stream.refinterval=refinterval;
+    stream.grid=make_bin_grid(1,0);
+    length=stream_series(infile,length,exclude,column,stream_value,&stream,
+                         verbosity);
+    stats_moments(&stream.stats,length,&moments);
+  }
+  else if (widen) {
+    /*Neither the data nor a second pass are needed*/
+    stream.n=0;
+    stream.notfinite=0;
+    stream.bins=make_doubling_bins(base);
+    length=stream_series(infile,length,exclude,column,widen_value,&stream,
+                         verbosity);
+    doubling_bins_finish(stream.bins);
+    if (stream.notfinite > 0)
+      fprintf(stderr,"%lu values that are not finite were not binned\n",
+              stream.notfinite);
+    stats_moments(&stream.stats,length,&moments);
+  }
+  else if (lowmem) {
+    /*Get the statistics now and bin in a second pass*/
+    stream.n=0;
+    again=first_pass_series(infile,&length,exclude,column,stream_stats,
+                            &stream,verbosity);
+    stats_moments(&stream.stats,length,&moments);
+  }
+  else {
+    series=(double*)get_series(infile,&length,exclude,column,verbosity);
+    column_moments(&series,1,length,&moments);
   }
 
-  /*Read data*/
-  series=(double*)get_series(infile,&length,exclude,column,verbosity);
-  variance(series,length,&average,&var);
-
-  /*Get data minimum and interval*/
-  min=interval=series[0];
-  for (i=1;i<length;i++) {
-    if (series[i] < min) min=series[i];
-    else if (series[i] > interval) interval=series[i];
+  /*Get data minimum, interval and variance, a file of a batch without
+    them is skipped*/
+  if ((length == 0) || !moments_variance(&moments,&average,&var)) {
+    if (minmaxfile != NULL || minmaxstring != NULL)
+      free_bin_grid(stream.grid);
+    else if (widen)
+      free_doubling_bins(stream.bins);
+    else if (again != NULL)
+      free_second_pass(again);
+    else
+      free_series(series);
+    return;
   }
-  interval -= min;
+  min=moments.min;
+  interval=moments.max-min;
 
   /*Settings*/
   if (minmaxfile != NULL || minmaxstring != NULL) {
@@ -230,6 +312,15 @@ int main(int argc,char **argv)
       range-=((long)((min+interval-refmin-refinterval)/size));
     }
   }
+  else if (widen) {
+    refmin=stream.bins->lo;
+    refinterval=(double)base*stream.bins->width;
+    size=stream.bins->width;
+    offset=0;
+    negoffset=0;
+    range=base;
+    fullrange=range;
+  }
   else {
     refmin=min;
     refinterval=interval;
@@ -246,14 +337,48 @@ int main(int argc,char **argv)
     for (i=negoffset;i<range;i++) {
       box[i]=0;
     }
-    for (i=0;i<length;i++) {
-      j=(long)((series[i]-refmin)*base/refinterval+offset);
-      if ((min+interval-refmin-refinterval) == 0.0) {
-        if (j == range) {
-          j=range-1;
+    if (widen && (minmaxfile == NULL) && (minmaxstring == NULL)) {
+      for (i=0;i<range;i++)
+        box[i]=stream.bins->count[i];
+      free_doubling_bins(stream.bins);
+    }
+    else if (again != NULL) {
+      stream.refmin=refmin;
+      stream.base=(double)base;
+      stream.refinterval=refinterval;
+      stream.box=box;
+      stream.offset=offset;
+      stream.range=range;
+      stream.fold=((min+interval-refmin-refinterval) == 0.0);
+      second_pass(again,bin_value,&stream);
+    }
+    else if (series == NULL) {
+      /*Move the streamed bins to their place, truncation puts values
+        just below the lowest bin into it*/
+      k=(long)offset;
+      bin_grid_finish(stream.grid,&k,NULL);
+      for (k=stream.grid->lo[0];
+           k<stream.grid->lo[0]+(long)stream.grid->n[0];k++) {
+        j=(k+(long)offset < 0) ? 0 : (unsigned long)(k+(long)offset);
+        if ((min+interval-refmin-refinterval) == 0.0) {
+          if (j == range) {
+            j=range-1;
+          }
         }
+        if ((j >= negoffset) && (j < range))
+          box[j] += stream.grid->count[k-stream.grid->lo[0]];
       }
-      box[j]++;
+      free_bin_grid(stream.grid);
+    }
+    else {
+      scale.min=refmin;
+      scale.base=(double)base;
+      scale.interval=refinterval;
+      scale.offset=(double)offset;
+      scale.range=range;
+      scale.edge=((min+interval-refmin-refinterval) == 0.0) ? BIN_FOLD :
+        BIN_DROP;
+      parallel_bin_count(series,length,&scale,box);
     }
   }
 
@@ -272,6 +397,8 @@ int main(int argc,char **argv)
     fprintf(fout,"#interval of data:   [%e:%e]\n",min,min+interval);
     if (minmaxfile != NULL || minmaxstring != NULL)
       fprintf(fout,"#reference interval: [%e:%e]\n",refmin,refmin+refinterval);
+    else if (widen)
+      fprintf(fout,"#binned interval:    [%e:%e]\n",refmin,refmin+refinterval);
     fprintf(fout,"#average= %e\n",average);
     fprintf(fout,"#standard deviation= %e\n",var);
     for (i=negoffset;i<range;i++) {
@@ -286,6 +413,8 @@ int main(int argc,char **argv)
     fprintf(stdout,"#interval of data:   [%e:%e]\n",min,min+interval);
     if (minmaxfile != NULL || minmaxstring != NULL)
       fprintf(stdout,"#reference interval: [%e:%e]\n",refmin,refmin+refinterval);
+    else if (widen)
+      fprintf(stdout,"#binned interval:    [%e:%e]\n",refmin,refmin+refinterval);
     fprintf(stdout,"#average= %e\n",average);
     fprintf(stdout,"#standard deviation= %e\n",var);
     for (i=negoffset;i<range;i++) {
@@ -294,5 +423,100 @@ int main(int argc,char **argv)
       fflush(stdout);
     }
   }
+
+  if (range > 0)
+    free(box);
+  else if (minmaxfile != NULL || minmaxstring != NULL)
+    free_bin_grid(stream.grid);
+  free_series(series);
+}
+
+/*Option -B, one histogram for each datafile*/
+void batch_histogram(char *name,void *data)
+{
+  char *out;
+
+  (void)data;
+  check_alloc(out=(char*)calloc(strlen(name)+5,1));
+  strcpy(out,name);
+  strcat(out,".his");
+  if (test_outfile(out))
+    make_histogram(name,out);
+  free(out);
+}
+
+int main(int argc,char **argv)
+{
+  char stdi=0,**files=NULL;
+  unsigned int nfiles=0;
+  FILE *test;
+
+  if (scan_help(argc,argv))
+    show_options(argv[0]);
+  
+  scan_options(argc,argv);
+#ifndef OMIT_WHAT_I_DO
+  if (verbosity&VER_INPUT)
+    what_i_do(argv[0],WID_STR);
+#endif
+
+  if (batch)
+    files=search_datafiles(argc,argv,&column,verbosity,&nfiles);
+  else
+    infile=search_datafile(argc,argv,&column,verbosity);
+  if ((infile == NULL) && (files == NULL))
+    stdi=1;
+
+  if ((outfile == NULL) && (files == NULL)) {
+    if (!stdi) {
+      check_alloc(outfile=(char*)calloc(strlen(infile)+5,1));
+      strcpy(outfile,infile);
+      strcat(outfile,".his");
+    }
+    else {
+      check_alloc(outfile=(char*)calloc((size_t)10,1));
+      strcpy(outfile,"stdin.his");
+    }
+  }
+  if (!my_stdout && (files == NULL))
+    test_outfile(outfile);
+
+  /*Get reference range for options '-r' and '-R'*/
+  if (minmaxfile != NULL) {
+    test=fopen(minmaxfile,"r");
+    if (test == NULL) {
+      fprintf(stderr,"File %s not found!\n",minmaxfile);
+      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
+    }
+    if (verbosity&VER_INPUT) {
+      fprintf(stderr,"Get reference range from %s, reading column %u\n",
+          minmaxfile,column);
+    }
+
+    minmax=(double*)get_series(minmaxfile,&minmaxlength,0,column,verbosity);
+    if (minmaxlength != 2) {
+      fprintf(stderr,"Wrong format in file '%s'. Needs exactly two lines"
+          " with minima and maxima for each column.\n",minmaxfile);
+      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
+    }
+  }
+
+  /*Get reference range for options '-s' and '-S'*/
+  if (minmaxstring != NULL) {
+    if (minmax == NULL) {
+      check_alloc(minmax=(double*)malloc(sizeof(double)*2));
+    }
+    sscanf(minmaxstring,"%lf,%lf",&minmax[0],&minmax[1]);
+  }
+
+  sample_lines(every,sample);
+  if (files != NULL) {
+    /*Every file is written to its own output, several at a time*/
+    my_stdout=0;
+    run_batch(nfiles,files,batch_histogram,NULL);
+    free(files);
+  }
+  else
+    make_histogram(infile,outfile);
   return 0;
 }
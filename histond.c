@@ -3,6 +3,13 @@
     2014/07/07: adapted version for n-dimensional histograms
     2014/07/07: option -F for relative frequencies
     2014/08/28: print out intervals and binwidths as comment line
+    2026/10/17: option -L to read the data twice instead of keeping them
+    2026/10/17: options -k and -n to read every k-th line or a sample
+    2026/10/17: option -B to make one histogram for each datafile
+    2026/10/17: bin on all processors
+    2026/10/17: keep the bins in a hash table if they don't fit into memory
+    2026/10/17: integer strides instead of pow, binning specialized on dim
+    2026/10/17: minimum and maximum of the columns in one pass
 */
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,18 +22,112 @@
 #endif
 
 #define WID_STR "Creates a n-d-histogram of a multivariate time series [2014/08/28: n-d-histogram]"
+/*Bins taking more bytes are kept in a hash table, only those hit*/
+#define DENSE_MAX (1UL<<28)
 
-unsigned long length=ULONG_MAX;
+unsigned long maxlength=ULONG_MAX;
 unsigned long exclude=0;
-unsigned int dim=2;
+unsigned long every=1,sample=0;
+unsigned int mdim=2;
 char *columns=NULL,dimset=0;
 unsigned int base=16;
 unsigned int verbosity=0xff;
 unsigned int stout=1;
-char density=1;
+char density=1,lowmem=0,batch=0;
 char *outfile=NULL;
 char *infile=NULL;
 
+/*State of the two passes of option -L*/
+struct passes {
+  unsigned long n;
+  struct column_stats *stats;
+  double *min,*interval,base_1;
+  unsigned long *box,*stride;
+  struct sparse_bins *sparse;
+};
+
+/*First pass, only the statistics*/
+void stream_stats(double *val,unsigned int dim,void *data)
+{
+  struct passes *p=(struct passes*)data;
+  unsigned int n;
+
+  if (p->stats == NULL)
+    check_alloc(p->stats=(struct column_stats*)
+                malloc(sizeof(struct column_stats)*dim));
+  for (n=0;n<dim;n++)
+    stats_add(&p->stats[n],p->n,val[n]);
+  p->n++;
+}
+
+/*Second pass, bins exactly like the loop over the series*/
+void bin_row(double *val,unsigned int dim,void *data)
+{
+  struct passes *p=(struct passes*)data;
+  unsigned long j=0;
+  unsigned int n,bi;
+
+  for (n=0;n<dim;n++) {
+    bi=(unsigned int)((val[n]-p->min[n])*p->base_1/p->interval[n]);
+    bi=(bi>=base)? base-1:bi;
+    j+=bi*p->stride[n];
+  }
+  if (p->sparse != NULL)
+    sparse_bins_add(p->sparse,j);
+  else
+    p->box[j]++;
+}
+
+/*What bin_cells needs, the series already start at 0. Bin bi[n] of
+  each dimension adds bi[n]*stride[n], stride[n]=base^(dim-1-n), to the
+  number of the bin*/
+struct cells {
+  double **series,*interval,base_1;
+  unsigned long *stride;
+  unsigned int dim;
+  struct sparse_bins *sparse;
+};
+
+/*The loop of bin_cells. It is inlined with a constant dim for each
+  dimension up to 8, so the compiler unrolls the inner loop*/
+static inline void bin_rows(unsigned long first,unsigned long last,
+                            long *box,struct cells *c,unsigned int dim)
+{
+  unsigned long i,j;
+  unsigned int n,bi;
+
+  for (i=first;i<last;i++) {
+    j=0;
+    for (n=0;n<dim;n++) {
+      bi=(unsigned int)(c->series[n][i]*c->base_1/c->interval[n]);
+      bi=(bi>=base)? base-1:bi;
+      j+=bi*c->stride[n];
+    }
+    if (c->sparse != NULL)
+      sparse_bins_add(c->sparse,j);
+    else
+      box[j]++;
+  }
+}
+
+/*Bins the rows first..last-1 of the series*/
+void bin_cells(unsigned long first,unsigned long last,long *box,void *data)
+{
+  struct cells *c=(struct cells*)data;
+
+  switch (c->dim) {
+  case 1: bin_rows(first,last,box,c,1); break;
+  case 2: bin_rows(first,last,box,c,2); break;
+  case 3: bin_rows(first,last,box,c,3); break;
+  case 4: bin_rows(first,last,box,c,4); break;
+  case 5: bin_rows(first,last,box,c,5); break;
+  case 6: bin_rows(first,last,box,c,6); break;
+  case 7: bin_rows(first,last,box,c,7); break;
+  case 8: bin_rows(first,last,box,c,8); break;
+  default: bin_rows(first,last,box,c,c->dim);
+  }
+}
+
 void show_options(char *progname)
 {
   what_i_do(progname,WID_STR);
@@ -37,13 +138,21 @@ void show_options(char *progname)
           " Just - also means stdin\n");
   fprintf(stderr,"\t-l length of file [default whole file]\n");
   fprintf(stderr,"\t-x # of lines to ignore [default %ld]\n",exclude);
-  fprintf(stderr,"\t-m # of components to be read [default %u]\n",dim);
+  fprintf(stderr,"\t-k read only every k-th line [default 1]\n");
+  fprintf(stderr,"\t-n read a random sample of # lines, of all datafiles"
+	  " together;\n\t   lines that aren't numbers are dropped from it"
+	  " [default all]\n");
+  fprintf(stderr,"\t-m # of components to be read [default %u]\n",mdim);
   fprintf(stderr,"\t-c columns to read [default 1,2]\n");
   fprintf(stderr,"\t-b # of intervals per dim [default %u]\n",base);
   fprintf(stderr,"\t-F output relative frequencies not densities"
 	  " [default not set]\n");
+  fprintf(stderr,"\t-L read the data twice instead of keeping them in"
+          " memory [default not set]\n");
   fprintf(stderr,"\t-o output file [default 'datafile'.his ;"
           " If no -o is given: stdout]\n");
+  fprintf(stderr,"\t-B write a histogram 'datafile'.his for each datafile,"
+          " several at a time\n\t   [default not set]\n");
   fprintf(stderr,"\t-V verbosity level [default 1]\n\t\t"
           "0='only panic messages'\n\t\t"
           "1='+ input/output messages'\n");
@@ -56,11 +165,15 @@ void scan_options(int n,char **argv)
   char *out;
 
   if ((out=check_option(argv,n,'l','u')) != NULL)
-    sscanf(out,"%lu",&length);
+    sscanf(out,"%lu",&maxlength);
   if ((out=check_option(argv,n,'x','u')) != NULL)
     sscanf(out,"%lu",&exclude);
+  if ((out=check_option(argv,n,'k','u')) != NULL)
+    sscanf(out,"%lu",&every);
+  if ((out=check_option(argv,n,'n','u')) != NULL)
+    sscanf(out,"%lu",&sample);
   if ((out=check_option(argv,n,'m','u')) != NULL) {
-    sscanf(out,"%u",&dim);
+    sscanf(out,"%u",&mdim);
     dimset=1;
   }
   if ((out=check_option(argv,n,'c','s')) != NULL)
@@ -71,6 +184,10 @@ void scan_options(int n,char **argv)
     sscanf(out,"%u",&verbosity);
   if ((out=check_option(argv,n,'F','n')) != NULL)
     density=0;
+  if ((out=check_option(argv,n,'L','n')) != NULL)
+    lowmem=1;
+  if ((out=check_option(argv,n,'B','n')) != NULL)
+    batch=1;
   if ((out=check_option(argv,n,'o','o')) != NULL) {
     stout=0;
     if (strlen(out) > 0)
@@ -78,65 +195,86 @@ void scan_options(int n,char **argv)
   }
 }
 
-int main(int argc,char **argv)
+/*Makes the histogram of one datafile, NULL for stdin*/
+void make_histogram(char *infile,char *outfile)
 {
-  char stdi=0;
   double base_1,norm2;
-  double min[dim],interval[dim];
-  double **series;
-  unsigned long i,j;
-  unsigned int n,bi[dim];
-  unsigned long *box;
-  FILE *fout=NULL;
+  double *min,*interval;
+  double **series=NULL;
+  struct moments *moments;
+  struct passes passes;
+  struct cells cells;
+  struct second_pass *again=NULL;
+  unsigned long i,hits,nbins,*stride,length=maxlength;
+  unsigned int n,dim=mdim,*digit;
+  unsigned long *box=NULL;
+  struct sparse_bins *sparse=NULL;
+  FILE *fout=NULL,*fhead=NULL;
 
-  if (scan_help(argc,argv))
-    show_options(argv[0]);
-
-  scan_options(argc,argv);
-#ifndef OMIT_WHAT_I_DO
-  if (verbosity&VER_INPUT)
-    what_i_do(argv[0],WID_STR);
-#endif
-
-  infile=search_datafile(argc,argv,NULL,verbosity);
-  if (infile == NULL)
-    stdi=1;
-
-  if (!stout && (outfile == NULL)) {
-    if (!stdi) {
-      check_alloc(outfile=calloc(strlen(infile)+5,(size_t)1));
-      sprintf(outfile,"%s.his",infile);
-    }
-    else {
-      check_alloc(outfile=calloc((size_t)10,(size_t)1));
-      sprintf(outfile,"stdin.his");
-    }
+  if (!stout && !test_outfile(outfile))
+    return;
+  if (lowmem) {
+    /*Get the statistics now and bin in a second pass*/
+    passes.n=0;
+    passes.stats=NULL;
+    again=first_pass_multi_series(infile,&length,exclude,&dim,
+                                  (columns == NULL) ? "" : columns,dimset,
+                                  stream_stats,&passes,verbosity);
   }
-
-  if (columns == NULL)
+  else if (columns == NULL)
     series=(double**)get_multi_series(infile,&length,exclude,&dim,"",dimset,
                                       verbosity);
   else
     series=(double**)get_multi_series(infile,&length,exclude,&dim,columns,
                                       dimset,verbosity);
+  /*A file of a batch without lines is skipped*/
+  if (length == 0) {
+    if (again != NULL) {
+      free_second_pass(again);
+      free(passes.stats);
+    }
+    else
+      free_multi_series(series,dim);
+    return;
+  }
 
+  check_alloc(min=(double*)malloc(sizeof(double)*dim));
+  check_alloc(interval=(double*)malloc(sizeof(double)*dim));
+  check_alloc(moments=(struct moments*)malloc(sizeof(struct moments)*dim));
+  if (series != NULL)
+    column_moments(series,dim,length,moments);
   for (n=0;n<dim;n++) {
-    min[n]=interval[n]=series[n][0];
-    for (i=1;i<length;i++) {
-      if (series[n][i] < min[n]) min[n]=series[n][i];
-      else if (series[n][i] > interval[n]) interval[n]=series[n][i];
+    if (series == NULL) {
+      min[n]=passes.stats[n].min;
+      interval[n]=passes.stats[n].max-min[n];
+      continue;
     }
-    interval[n] -= min[n];
+    min[n]=moments[n].min;
+    interval[n]=moments[n].max-min[n];
 
     for (i=0;i<length;i++) {
       series[n][i]=(series[n][i]-min[n]);
     }
   }
 
-  check_alloc(box=(unsigned long*)malloc(sizeof(unsigned long*)*pow(base,dim)));
-  for (i=0;i<pow(base,dim);i++)
-  {
-    box[i]=1;
+  check_alloc(stride=(unsigned long*)malloc(sizeof(unsigned long)*dim));
+  check_alloc(digit=(unsigned int*)calloc((size_t)dim,sizeof(unsigned int)));
+  nbins=1;
+  for (n=dim;n-- > 0;) {
+    stride[n]=nbins;
+    nbins *= base;
+  }
+
+  /*Every bin starts with a count of 1. The hash table only counts the
+    values, the 1 is added when the bins are printed*/
+  if ((double)sizeof(unsigned long)*pow(base,dim) > (double)DENSE_MAX)
+    sparse=make_sparse_bins();
+  else {
+    check_alloc(box=(unsigned long*)malloc(sizeof(unsigned long)*nbins));
+    for (i=0;i<nbins;i++)
+    {
+      box[i]=1;
+    }
   }
   base_1=(double)base;
   norm2=(double)(length+pow(base,dim));
@@ -146,21 +284,31 @@ int main(int argc,char **argv)
     }
   }
 
-  for (i=0;i<length;i++) {
-    j=0;
-    for (n=0;n<dim;n++) {
-      bi[n]=(unsigned int)(series[n][i]*base_1/interval[n]);
-      bi[n]=(bi[n]>=base)? base-1:bi[n];
-      j+=bi[n]*pow(base,dim-1-n);
-    }
-    box[j]++;
+  if (again != NULL) {
+    passes.min=min;
+    passes.interval=interval;
+    passes.base_1=base_1;
+    passes.box=box;
+    passes.stride=stride;
+    passes.sparse=sparse;
+    second_pass(again,bin_row,&passes);
+    free(passes.stats);
+  }
+  else {
+    cells.series=series;
+    cells.interval=interval;
+    cells.base_1=base_1;
+    cells.stride=stride;
+    cells.dim=dim;
+    cells.sparse=sparse;
+    if (sparse != NULL)
+      bin_cells(0,length,NULL,&cells);
+    else
+      parallel_bins(length,nbins,bin_cells,&cells,(long*)box);
   }
-
-  if (!stout)
-    test_outfile(outfile);
 
   /* print out intervals */
-  fout=fopen(outfile,"w");
+  fhead=fout=fopen(outfile,"w");
   if (stout) {
     fprintf(stdout,"#intervals: ");
     for (n=0;n<dim;n++) {
@@ -196,25 +344,25 @@ int main(int argc,char **argv)
     fprintf(fout,"\n");
   }
 
-  /* print out histogram */
-  for (i=0;i<pow(base,dim);i++) {
+  /* print out histogram, digit[] counts through the bins of each
+     dimension like an odometer */
+  for (i=0;i<nbins;i++) {
+    hits=(sparse != NULL) ? 1+sparse_bins_count(sparse,i) : box[i];
     if (stout) {
       for (n=0;n<dim;n++) {
-        fprintf(stdout,"%e ",
-                ((double)(((i)/(unsigned int)
-                    pow(base,dim-1-n))%base)+0.5)*interval[n]+min[n]);
+        fprintf(stdout,"%e ",((double)digit[n]+0.5)*interval[n]+min[n]);
       }
-      fprintf(stdout,"%e\n",(double)box[i]/norm2);
+      fprintf(stdout,"%e\n",(double)hits/norm2);
     }
     else {
       for (n=0;n<dim;n++) {
-        fprintf(fout,"%e ",
-                ((double)(((i)/(unsigned int)
-                    pow(base,dim-1-n))%base)+0.5)*interval[n]+min[n]);
+        fprintf(fout,"%e ",((double)digit[n]+0.5)*interval[n]+min[n]);
       }
-      fprintf(fout,"%e\n",(double)box[i]/norm2);
+      fprintf(fout,"%e\n",(double)hits/norm2);
     }
-    if (!((i+1)%base)) {
+    for (n=dim;(n-- > 0) && (++digit[n] == base);)
+      digit[n]=0;
+    if (digit[dim-1] == 0) {
       if (stout)
         fprintf(stdout,"\n");
       else
@@ -223,16 +371,82 @@ int main(int argc,char **argv)
   }
   if (!stout)
     fclose(fout);
+  /*The intervals line goes over the start of the file, as it always did,
+    but the first stream isn't left open for every file of a batch*/
+  if (fhead != NULL)
+    fclose(fhead);
+
+  if (sparse != NULL)
+    free_sparse_bins(sparse);
+  else
+    free(box);
+  free(min);
+  free(interval);
+  free(stride);
+  free(digit);
+  free(moments);
+  if (series != NULL)
+    free_multi_series(series,dim);
+}
+
+/*Option -B, one histogram for each datafile*/
+void batch_histogram(char *name,void *data)
+{
+  char *out;
+
+  (void)data;
+  check_alloc(out=calloc(strlen(name)+5,(size_t)1));
+  sprintf(out,"%s.his",name);
+  make_histogram(name,out);
+  free(out);
+}
+
+int main(int argc,char **argv)
+{
+  char stdi=0,**files=NULL;
+  unsigned int nfiles=0;
+
+  if (scan_help(argc,argv))
+    show_options(argv[0]);
+
+  scan_options(argc,argv);
+#ifndef OMIT_WHAT_I_DO
+  if (verbosity&VER_INPUT)
+    what_i_do(argv[0],WID_STR);
+#endif
+
+  if (batch)
+    files=search_datafiles(argc,argv,NULL,verbosity,&nfiles);
+  else
+    infile=search_datafile(argc,argv,NULL,verbosity);
+  if ((infile == NULL) && (files == NULL))
+    stdi=1;
+
+  sample_lines(every,sample);
+  if (files != NULL) {
+    /*Every file is written to its own output, several at a time*/
+    stout=0;
+    run_batch(nfiles,files,batch_histogram,NULL);
+    free(files);
+  }
+  else {
+    if (!stout && (outfile == NULL)) {
+      if (!stdi) {
+        check_alloc(outfile=calloc(strlen(infile)+5,(size_t)1));
+        sprintf(outfile,"%s.his",infile);
+      }
+      else {
+        check_alloc(outfile=calloc((size_t)10,(size_t)1));
+        sprintf(outfile,"stdin.his");
+      }
+    }
+    make_histogram(infile,outfile);
+  }
 
   /*Freeing all allocated arrays*/
   if (outfile != NULL) free(outfile);
   if (infile != NULL) free(infile);
   if (columns != NULL) free(columns);
-  free(box);
-  for (n=0;n<dim;n++) {
-    free(series[n]);
-  }
-  free(series);
 
   return 0;
 }
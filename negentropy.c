@@ -1,5 +1,9 @@
 /*Derived from source code by Rainer Hegger. */
 /*Author: Bjoern Bastian.
+    2026/10/17: option -B to compute the negentropies of each datafile
+    2026/10/17: bin the series with the shared binning kernel
+    2026/10/17: bin on all processors
+    2026/10/17: minimum, maximum and variance in one pass
 */
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,10 +17,11 @@
 
 #define WID_STR "Calculates column-wise negentropies from 1d-histogram"
 
-unsigned long length=ULONG_MAX;
-unsigned int dim=1;
+unsigned long maxlength=ULONG_MAX;
+unsigned int mdim=1;
 unsigned long minmaxlength=3;
 unsigned long exclude=0;
+unsigned long every=1,sample=0;
 unsigned int base=300;
 unsigned int verbosity=0xff;
 char *columns=NULL,dimset=0;
@@ -24,6 +29,48 @@ unsigned int stout=1;
 char *outfile=NULL;
 char *infile=NULL;
 char *minmaxfile=NULL;
+char lowmem=0,batch=0;
+double **minmax=NULL;
+
+/*State of the two passes of option -L*/
+struct passes {
+  unsigned long n;
+  struct column_stats *stats;
+  unsigned long *offset,*range;
+  double *refmin,*refinterval;
+  unsigned long **box;
+};
+
+/*First pass, only the statistics*/
+void stream_stats(double *val,unsigned int dim,void *data)
+{
+  struct passes *p=(struct passes*)data;
+  unsigned int i;
+
+  if (p->stats == NULL)
+    check_alloc(p->stats=(struct column_stats*)
+                malloc(sizeof(struct column_stats)*dim));
+  for (i=0;i<dim;i++)
+    stats_add(&p->stats[i],p->n,val[i]);
+  p->n++;
+}
+
+/*Second pass, bins exactly like the loop over the series*/
+void bin_row(double *val,unsigned int dim,void *data)
+{
+  struct passes *p=(struct passes*)data;
+  unsigned int i;
+  unsigned long k;
+
+  for (i=0;i<dim;i++)
+    if (p->range[i] > 0) {
+      k=(long)((val[i]-p->refmin[i])*base/p->refinterval[i]+p->offset[i]);
+      if (k >= p->range[i]) {
+        k=p->range[i]-1;
+      }
+      p->box[i][k]++;
+    }
+}
 
 void show_options(char *progname)
 {
@@ -35,12 +82,20 @@ void show_options(char *progname)
           " Just - also means stdin\n");
   fprintf(stderr,"\t-l # of lines to use [default is whole file]\n");
   fprintf(stderr,"\t-x # of lines to ignore [default %ld]\n",exclude);
-  fprintf(stderr,"\t-m # of components to be read [default %u]\n",dim);
+  fprintf(stderr,"\t-k read only every k-th line [default 1]\n");
+  fprintf(stderr,"\t-n read a random sample of # lines, of all datafiles"
+	  " together;\n\t   lines that aren't numbers are dropped from it"
+	  " [default all]\n");
+  fprintf(stderr,"\t-m # of components to be read [default %u]\n",mdim);
   fprintf(stderr,"\t-c column selection [default 1,...,# of components]\n");
   fprintf(stderr,"\t-b # of intervals per dim [default %u]\n",base);
   fprintf(stderr,"\t-r reference file for binning range [optional]\n");
+  fprintf(stderr,"\t-L read the data twice instead of keeping them in"
+          " memory [default not set]\n");
   fprintf(stderr,"\t-o output file [default 'datafile'.nen ;"
           " If no -o is given: stdout]\n");
+  fprintf(stderr,"\t-B write the negentropies of each datafile to"
+          " 'datafile'.nen,\n\t   several at a time [default not set]\n");
   fprintf(stderr,"\t-V verbosity level [default 1]\n\t\t"
           "0='only panic messages'\n\t\t"
           "1='+ input/output messages'\n");
@@ -53,11 +108,15 @@ void scan_options(int n,char **argv)
   char *out;
 
   if ((out=check_option(argv,n,'l','u')) != NULL)
-    sscanf(out,"%lu",&length);
+    sscanf(out,"%lu",&maxlength);
   if ((out=check_option(argv,n,'x','u')) != NULL)
     sscanf(out,"%lu",&exclude);
+  if ((out=check_option(argv,n,'k','u')) != NULL)
+    sscanf(out,"%lu",&every);
+  if ((out=check_option(argv,n,'n','u')) != NULL)
+    sscanf(out,"%lu",&sample);
   if ((out=check_option(argv,n,'m','u')) != NULL) {
-    sscanf(out,"%u",&dim);
+    sscanf(out,"%u",&mdim);
     dimset=1;
   }
   if ((out=check_option(argv,n,'c','s')) != NULL)
@@ -70,6 +129,10 @@ void scan_options(int n,char **argv)
     if (strlen(out) > 0)
       minmaxfile=out;
   }
+  if ((out=check_option(argv,n,'L','n')) != NULL)
+    lowmem=1;
+  if ((out=check_option(argv,n,'B','n')) != NULL)
+    batch=1;
   if ((out=check_option(argv,n,'o','o')) != NULL) {
     stout=0;
     if (strlen(out) > 0)
@@ -77,80 +140,46 @@ void scan_options(int n,char **argv)
   }
 }
 
-int main(int argc,char **argv)
+/*Computes the negentropies of one datafile, NULL for stdin*/
+void make_negentropy(char *infile,char *outfile)
 {
-  char stdi=0;
-  unsigned long i,j,k;
+  unsigned long i,j,length=maxlength;
   unsigned long *offset,*negoffset,*range;
+  unsigned int dim=mdim;
   double entropygauss;
   double pi=3.14159265358979;
   double e=2.71828182845905;
   double x,norm,*size;
   double *min,*interval,*refmin,*refinterval;
-  double **series,**minmax;
+  double **series=NULL;
   double *average,*std,*entropy;
+  struct moments *moments;
+  struct passes passes;
+  struct second_pass *again=NULL;
+  struct bin_scale scale;
   unsigned long **box;
-  FILE *fout=NULL,*test=NULL;
-
-  if (scan_help(argc,argv))
-    show_options(argv[0]);
+  FILE *fout=NULL;
 
-  scan_options(argc,argv);
-#ifndef OMIT_WHAT_I_DO
-  if (verbosity&VER_INPUT)
-    what_i_do(argv[0],WID_STR);
-#endif
-
-  /*Get reference range for option '-r'*/
+  if (!stout && !test_outfile(outfile))
+    return;
   check_alloc(refmin=(double*)malloc(sizeof(double)*dim));
   check_alloc(refinterval=(double*)malloc(sizeof(double)*dim));
-  if (minmaxfile != NULL) {
-    test=fopen(minmaxfile,"r");
-    if (test == NULL) {
-      fprintf(stderr,"File %s not found!\n",minmaxfile);
-      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
-    }
-    if (verbosity&VER_INPUT) {
-      fprintf(stderr,"Get reference ranges from file %s\n",minmaxfile);
-    }
-
-    if (columns == NULL) {
-      minmax=(double**)get_multi_series(minmaxfile,&minmaxlength,0,&dim,"",
-                                          dimset,verbosity);
-    }
-    else {
-      minmax=(double**)get_multi_series(minmaxfile,&minmaxlength,0,&dim,columns,
-                                        dimset,verbosity);
-    }
-
-    if(minmaxlength!=2) {
-      fprintf(stderr,"Wrong format in file '%s'. Needs exactly two lines"
-          " with minima and maxima for each column.\n",minmaxfile);
-      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
-    }
+  if (minmax != NULL) {
     for (i=0;i<dim;i++) {
       refmin[i]=minmax[i][0];
       refinterval[i]=minmax[i][1]-refmin[i];
     }
   }
 
-  /*Read data*/
-  infile=search_datafile(argc,argv,NULL,verbosity);
-  if (infile == NULL)
-    stdi=1;
-
-  if (!stout && (outfile == NULL)) {
-    if (!stdi) {
-      check_alloc(outfile=calloc(strlen(infile)+5,(size_t)1));
-      sprintf(outfile,"%s.nen",infile);
-    }
-    else {
-      check_alloc(outfile=calloc((size_t)10,(size_t)1));
-      sprintf(outfile,"stdin.nen");
-    }
+  if (lowmem) {
+    /*Get the statistics now and bin in a second pass*/
+    passes.n=0;
+    passes.stats=NULL;
+    again=first_pass_multi_series(infile,&length,exclude,&dim,
+                                  (columns == NULL) ? "" : columns,dimset,
+                                  stream_stats,&passes,verbosity);
   }
-
-  if (columns == NULL)
+  else if (columns == NULL)
     series=(double**)get_multi_series(infile,&length,exclude,&dim,"",dimset,
                     verbosity);
   else
@@ -162,18 +191,38 @@ int main(int argc,char **argv)
   check_alloc(interval=(double*)malloc(sizeof(double)*dim));
   check_alloc(average=(double*)malloc(sizeof(double)*dim));
   check_alloc(std=(double*)malloc(sizeof(double)*dim));
-  for (i=0;i<dim;i++) {
-    min[i]=interval[i]=series[i][0];
-    for (j=1;j<length;j++) {
-      if (series[i][j] < min[i]) min[i]=series[i][j];
-      else if (series[i][j] > interval[i]) interval[i]=series[i][j];
-    }
+  check_alloc(moments=(struct moments*)malloc(sizeof(struct moments)*dim));
+  if (series != NULL)
+    column_moments(series,dim,length,moments);
+  for (i=0;(i<dim) && (length>0);i++) {
+    if (series == NULL)
+      stats_moments(&passes.stats[i],length,&moments[i]);
+    min[i]=moments[i].min;
+    interval[i]=moments[i].max;
+  /*moments_variance calculates standard deviation!*/
+    if (!moments_variance(&moments[i],&average[i],&std[i]))
+      break;
     interval[i] -= min[i];
-  /*variance calculates standard deviation!*/
-    variance(series[i],length,&average[i],&std[i]);
   /*use the unbiased estimator*/
   std[i]*=pow((double)length/(double)(length-1),0.5);
   }
+  /*A file of a batch without lines or variance is skipped*/
+  if (i < dim) {
+    if (again != NULL) {
+      free_second_pass(again);
+      free(passes.stats);
+    }
+    else
+      free_multi_series(series,dim);
+    free(min);
+    free(interval);
+    free(average);
+    free(std);
+    free(moments);
+    free(refmin);
+    free(refinterval);
+    return;
+  }
 
   /*Settings*/
   check_alloc(size=(double*)malloc(sizeof(double)*dim));
@@ -212,16 +261,28 @@ int main(int argc,char **argv)
       check_alloc(box[i]=(long*)malloc(sizeof(long)*range[i]));
       for (j=negoffset[i];j<range[i];j++)
         box[i][j]=0;
-      for (j=0;j<length;j++) {
-        k=(long)((series[i][j]-refmin[i])*base/refinterval[i]+offset[i]);
-        if (k >= range[i]) {
-          k=range[i]-1;
-        }
-        box[i][k]++;
-      }
+      if (again != NULL)
+        continue;
+      scale.min=refmin[i];
+      scale.base=(double)base;
+      scale.interval=refinterval[i];
+      scale.offset=(double)offset[i];
+      scale.range=range[i];
+      scale.edge=BIN_CLAMP;
+      parallel_bin_count(series[i],length,&scale,(long*)box[i]);
     }
   }
 
+  if (again != NULL) {
+    passes.offset=offset;
+    passes.range=range;
+    passes.refmin=refmin;
+    passes.refinterval=refinterval;
+    passes.box=box;
+    second_pass(again,bin_row,&passes);
+    free(passes.stats);
+  }
+
   /*Entropy*/
   check_alloc(entropy=(double*)malloc(sizeof(double)*dim));
   norm=1.0/(double)length;
@@ -236,7 +297,6 @@ int main(int argc,char **argv)
   }
 
   if (!stout) {
-    test_outfile(outfile);
     fout=fopen(outfile,"w");
     if (verbosity&VER_INPUT)
       fprintf(stderr,"Opened %s for writing\n",outfile);
@@ -264,24 +324,116 @@ int main(int argc,char **argv)
     }
   }
 
-  /*Freeing all allocated arrays*/
-  if (outfile != NULL) free(outfile);
-  if (infile != NULL) free(infile);
-  if (columns != NULL) free(columns);
   for (i=0;i<dim;i++) {
+    if (range[i] > 0)
       free(box[i]);
   }
   free(box);
-  for (i=0;i<dim;i++) {
-    free(series[i]);
-  }
-  free(series);
+  if (series != NULL)
+    free_multi_series(series,dim);
   free(entropy);
+  free(min);
+  free(interval);
+  free(average);
+  free(std);
+  free(moments);
+  free(size);
+  free(offset);
+  free(negoffset);
+  free(range);
+  free(refmin);
+  free(refinterval);
+}
+
+/*Option -B, the negentropies of each datafile*/
+void batch_negentropy(char *name,void *data)
+{
+  char *out;
+
+  (void)data;
+  check_alloc(out=calloc(strlen(name)+5,(size_t)1));
+  sprintf(out,"%s.nen",name);
+  make_negentropy(name,out);
+  free(out);
+}
+
+int main(int argc,char **argv)
+{
+  char stdi=0,**files=NULL;
+  unsigned int nfiles=0;
+  FILE *test=NULL;
+
+  if (scan_help(argc,argv))
+    show_options(argv[0]);
+
+  scan_options(argc,argv);
+#ifndef OMIT_WHAT_I_DO
+  if (verbosity&VER_INPUT)
+    what_i_do(argv[0],WID_STR);
+#endif
+
+  /*Get reference range for option '-r'*/
   if (minmaxfile != NULL) {
-    for (i=0;i<dim;i++) {
-      free(minmax[i]);
+    test=fopen(minmaxfile,"r");
+    if (test == NULL) {
+      fprintf(stderr,"File %s not found!\n",minmaxfile);
+      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
+    }
+    if (verbosity&VER_INPUT) {
+      fprintf(stderr,"Get reference ranges from file %s\n",minmaxfile);
+    }
+
+    if (columns == NULL) {
+      minmax=(double**)get_multi_series(minmaxfile,&minmaxlength,0,&mdim,"",
+                                          dimset,verbosity);
+    }
+    else {
+      minmax=(double**)get_multi_series(minmaxfile,&minmaxlength,0,&mdim,
+                                        columns,dimset,verbosity);
+    }
+
+    if(minmaxlength!=2) {
+      fprintf(stderr,"Wrong format in file '%s'. Needs exactly two lines"
+          " with minima and maxima for each column.\n",minmaxfile);
+      exit(HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT);
     }
-    free(minmax);
+  }
+
+  /*Read data*/
+  sample_lines(every,sample);
+  if (batch)
+    files=search_datafiles(argc,argv,NULL,verbosity,&nfiles);
+  else
+    infile=search_datafile(argc,argv,NULL,verbosity);
+  if ((infile == NULL) && (files == NULL))
+    stdi=1;
+
+  if (files != NULL) {
+    /*Every file is written to its own output, several at a time*/
+    stout=0;
+    run_batch(nfiles,files,batch_negentropy,NULL);
+    free(files);
+  }
+  else {
+    if (!stout && (outfile == NULL)) {
+      if (!stdi) {
+        check_alloc(outfile=calloc(strlen(infile)+5,(size_t)1));
+        sprintf(outfile,"%s.nen",infile);
+      }
+      else {
+        check_alloc(outfile=calloc((size_t)10,(size_t)1));
+        sprintf(outfile,"stdin.nen");
+      }
+    }
+    make_negentropy(infile,outfile);
+  }
+
+  /*Freeing all allocated arrays*/
+  if (outfile != NULL) free(outfile);
+  if (infile != NULL) free(infile);
+  if (columns != NULL) free(columns);
+  if (minmaxfile != NULL) {
+    free_multi_series(minmax,mdim);
     free(minmaxfile);
   }
 
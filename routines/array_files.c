@@ -0,0 +1,227 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Inputs that are arrays of numbers rather than text: the binary
+  column files of text2bin, NumPy .npy files and raw files. A raw file
+  has the extension .f32 or .f64 and holds little endian float32 or
+  float64 values row by row; TISEAN_RAW_COLUMNS gives the number of
+  columns, 1 if it is not set. An .npy file may hold <f4 or <f8 values
+  of one or two dimensions in C or Fortran order. All of them are
+  described by an array_layout, the distances in bytes between
+  successive rows and columns, so any column can be read in place
+  from the mapped file. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#define NPY_MAGIC "\223NUMPY"
+
+static void bad_array(char *name,char *why)
+{
+  fprintf(stderr,"%s is not a valid array file: %s. Exiting!\n",
+	  (name == NULL) ? "input" : name,why);
+  exit(BINARY_COLUMNS_WRONG_FORMAT);
+}
+
+static int little_endian(void)
+{
+  unsigned int one=1;
+
+  return *(unsigned char*)&one == 1;
+}
+
+/* the text after 'key': in the header dictionary h */
+static char *npy_value(char *name,char *h,char *key)
+{
+  char *p;
+
+  if ((p=strstr(h,key)) == NULL)
+    bad_array(name,"incomplete .npy header");
+  p += strlen(key);
+  while ((*p == ' ') || (*p == ':'))
+    p++;
+  return p;
+}
+
+static void npy_layout(char *name,char *map,unsigned long size,
+		       struct array_layout *a)
+{
+  char *h,*p,*rest;
+  unsigned long start,hlen,dim[2];
+  unsigned int ndim=0;
+  int fortran;
+
+  if (size < 12)
+    bad_array(name,"file too short");
+  if (map[6] == 1) {
+    hlen=(unsigned long)(unsigned char)map[8]|
+      ((unsigned long)(unsigned char)map[9] << 8);
+    start=10;
+  }
+  else {
+    hlen=(unsigned long)(unsigned char)map[8]|
+      ((unsigned long)(unsigned char)map[9] << 8)|
+      ((unsigned long)(unsigned char)map[10] << 16)|
+      ((unsigned long)(unsigned char)map[11] << 24);
+    start=12;
+  }
+  if (hlen > size-start)
+    bad_array(name,"header does not match the file size");
+  check_alloc(h=(char*)malloc(hlen+1));
+  memcpy(h,map+start,hlen);
+  h[hlen]='\0';
+
+  p=npy_value(name,h,"'descr'");
+  if (!strncmp(p,"'<f8'",(size_t)5))
+    a->size=8;
+  else if (!strncmp(p,"'<f4'",(size_t)5))
+    a->size=4;
+  else
+    bad_array(name,"only little endian float32 and float64 are supported");
+  p=npy_value(name,h,"'fortran_order'");
+  fortran=!strncmp(p,"True",(size_t)4);
+  p=npy_value(name,h,"'shape'");
+  if (*p++ != '(')
+    bad_array(name,"can't read the shape");
+  for (;;) {
+    while (*p == ' ')
+      p++;
+    if (*p == ')')
+      break;
+    if (ndim == 2)
+      bad_array(name,"more than two dimensions");
+    dim[ndim]=strtoul(p,&rest,10);
+    if (rest == p)
+      bad_array(name,"can't read the shape");
+    ndim++;
+    for (p=rest;(*p == ' ') || (*p == ',');p++);
+  }
+  free(h);
+  if (ndim == 0)
+    bad_array(name,"a single number is no time series");
+
+  a->rows=dim[0];
+  a->cols=(ndim == 2) ? dim[1] : 1;
+  a->data=map+start+hlen;
+  if ((a->cols > 0) && (a->rows > (size-start-hlen)/a->size/a->cols))
+    bad_array(name,"data do not match the shape");
+  if (fortran) {
+    a->row_step=a->size;
+    a->col_step=a->size*a->rows;
+  }
+  else {
+    a->row_step=a->size*a->cols;
+    a->col_step=a->size;
+  }
+}
+
+static int raw_layout(char *name,char *map,unsigned long size,
+		      struct array_layout *a)
+{
+  char *ext,*c;
+  unsigned long cols=1;
+
+  if ((name == NULL) || ((ext=strrchr(name,'.')) == NULL))
+    return 0;
+  if (!strcmp(ext,".f64"))
+    a->size=8;
+  else if (!strcmp(ext,".f32"))
+    a->size=4;
+  else
+    return 0;
+  if ((c=getenv("TISEAN_RAW_COLUMNS")) != NULL) {
+    cols=strtoul(c,NULL,10);
+    if (cols == 0) {
+      fprintf(stderr,"TISEAN_RAW_COLUMNS has to be a positive number."
+	      " Exiting!\n");
+      exit(BINARY_COLUMNS_WRONG_FORMAT);
+    }
+  }
+  if (size%(cols*a->size))
+    bad_array(name,"size is no multiple of the row size");
+  a->data=map;
+  a->cols=cols;
+  a->rows=size/(cols*a->size);
+  a->row_step=a->size*cols;
+  a->col_step=a->size;
+
+  return 1;
+}
+
+/* fills a for a mapped array file. Returns 0 if it is text */
+int array_layout(char *name,char *map,unsigned long size,
+		 struct array_layout *a)
+{
+  struct binary_header *h;
+  int npy,raw=0;
+
+  if (is_binary_file(map,size)) {
+    h=check_binary_file(name,map,size);
+    a->data=map+h->data;
+    a->rows=(unsigned long)h->rows;
+    a->cols=(unsigned long)h->cols;
+    a->size=8;
+    a->row_step=sizeof(double);
+    a->col_step=sizeof(double)*a->rows;
+    return 1;
+  }
+  npy=(size >= 8) && !memcmp(map,NPY_MAGIC,(size_t)6);
+  if (!npy && !(raw=raw_layout(name,map,size,a)))
+    return 0;
+  if (!little_endian())
+    bad_array(name,"only little endian systems can read it");
+  if (npy)
+    npy_layout(name,map,size,a);
+
+  return 1;
+}
+
+/* element (row,col) of the array, col counting from 0 */
+double array_element(struct array_layout *a,unsigned long row,
+		     unsigned long col)
+{
+  char *p=a->data+row*a->row_step+col*a->col_step;
+  double x;
+  float f;
+
+  if (a->size == 8) {
+    memcpy(&x,p,sizeof(double));
+    return x;
+  }
+  memcpy(&f,p,sizeof(float));
+  return (double)f;
+}
+
+/* exits if a column of plan is not in the array */
+void check_array_columns(char *name,struct array_layout *a,
+			 struct column_plan *plan)
+{
+  unsigned int i;
+
+  for (i=0;i<plan->n;i++)
+    if (plan->col[i] > a->cols) {
+      fprintf(stderr,"Column %u requested, but %s has only %lu columns."
+	      " Exiting!\n",plan->col[i],(name == NULL) ? "input" : name,
+	      a->cols);
+      exit(BINARY_COLUMNS_WRONG_FORMAT);
+    }
+}
+#undef NPY_MAGIC
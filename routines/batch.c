@@ -0,0 +1,200 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Batch mode of the histogram programs. run_batch calls a
+  batch_function for each of n data files on a pool of one thread per
+  processor. Every thread has a deque of files, dealt out largest first,
+  takes its files from the front and, once they are done, steals from
+  the back of the others, so a few large files don't keep the pool
+  waiting on one thread. A file that can't be used, because it has no
+  lines, no variance or its output can't be written, doesn't end the
+  program: skip_batch_file reports it and the tool goes on with the
+  next one. The workers share the processors: every file is read and
+  binned with the threads of its worker's share, see thread_budget. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "tsa.h"
+
+#define MAX_THREADS 64
+
+struct deque {
+  unsigned int *job;
+  unsigned int head,tail;   /* the files job[head,tail) are left */
+  pthread_mutex_t lock;
+};
+
+struct pool {
+  struct deque *q;
+  unsigned int nq;
+  char **names;
+  batch_function work;
+  void *data;
+  long share;             /* processors per worker */
+};
+
+struct worker {
+  struct pool *p;
+  unsigned int self;
+};
+
+static unsigned long *sizes;
+/* the file of the batch the thread works on */
+static _Thread_local char *current=NULL;
+/* the processors of the thread's worker, 0 outside of a batch */
+static _Thread_local long share=0;
+
+static int larger_first(const void *a,const void *b)
+{
+  unsigned long sa=sizes[*(const unsigned int*)a];
+  unsigned long sb=sizes[*(const unsigned int*)b];
+
+  return (sa < sb) ? 1 : (sa > sb) ? -1 : 0;
+}
+
+/* the next file of deque q, from the front for its owner and from the
+   back for thieves; 0 if it is empty */
+static int take(struct deque *q,int own,unsigned int *job)
+{
+  int got=0;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->head < q->tail) {
+    *job=own ? q->job[q->head++] : q->job[--q->tail];
+    got=1;
+  }
+  pthread_mutex_unlock(&q->lock);
+  return got;
+}
+
+static void *work(void *arg)
+{
+  struct worker *w=(struct worker*)arg;
+  struct pool *p=w->p;
+  unsigned int v,job;
+
+  share=p->share;
+  for (;;) {
+    if (!take(&p->q[w->self],1,&job)) {
+      /* no files are added, so once all deques are empty we are done */
+      for (v=1;v<p->nq;v++)
+	if (take(&p->q[(w->self+v)%p->nq],0,&job))
+	  break;
+      if (v >= p->nq) {
+	share=0;
+	return NULL;
+      }
+    }
+    current=p->names[job];
+    p->work(p->names[job],p->data);
+    current=NULL;
+  }
+}
+
+/* reports that the file of the batch is skipped and returns 1, outside
+   of a batch it returns 0 and the caller exits as it always did */
+int skip_batch_file(char *why)
+{
+  if (current == NULL)
+    return 0;
+  fprintf(stderr,"%s: %s. Skipping it!\n",current,why);
+  return 1;
+}
+
+/* the processors the calling thread may keep busy with threads of its
+   own: all of them, in a batch its worker's share */
+long thread_budget(void)
+{
+  long t=1;
+
+  if (share > 0)
+    return share;
+#ifdef _SC_NPROCESSORS_ONLN
+  t=sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return (t < 1) ? 1 : t;
+}
+
+static unsigned int batch_threads(unsigned int n)
+{
+  long t=thread_budget();
+
+  if (t > MAX_THREADS)
+    t=MAX_THREADS;
+  return ((unsigned long)t < n) ? (unsigned int)t : n;
+}
+
+void run_batch(unsigned int n,char **names,batch_function f,void *data)
+{
+  struct pool p;
+  struct worker w[MAX_THREADS];
+  pthread_t thread[MAX_THREADS];
+  struct stat st;
+  unsigned int i,t,*order,started=0;
+
+  if (n == 0)
+    return;
+  check_alloc(sizes=(unsigned long*)malloc(sizeof(unsigned long)*n));
+  check_alloc(order=(unsigned int*)malloc(sizeof(unsigned int)*n));
+  for (i=0;i<n;i++) {
+    sizes[i]=(stat(names[i],&st) == 0) ? (unsigned long)st.st_size : 0;
+    order[i]=i;
+  }
+  qsort(order,(size_t)n,sizeof(unsigned int),larger_first);
+
+  p.nq=batch_threads(n);
+  p.share=thread_budget()/(long)p.nq;
+  if (p.share < 1)
+    p.share=1;
+  p.names=names;
+  p.work=f;
+  p.data=data;
+  check_alloc(p.q=(struct deque*)malloc(sizeof(struct deque)*p.nq));
+  for (t=0;t<p.nq;t++) {
+    check_alloc(p.q[t].job=(unsigned int*)
+		malloc(sizeof(unsigned int)*(n/p.nq+1)));
+    p.q[t].head=p.q[t].tail=0;
+    pthread_mutex_init(&p.q[t].lock,NULL);
+  }
+  for (i=0;i<n;i++)
+    p.q[i%p.nq].job[p.q[i%p.nq].tail++]=order[i];
+
+  /* the calling thread works as number 0 */
+  for (t=0;t<p.nq;t++) {
+    w[t].p= &p;
+    w[t].self=t;
+  }
+  for (t=1;t<p.nq;t++)
+    if (pthread_create(&thread[started],NULL,work,&w[t]) == 0)
+      started++;
+  work(&w[0]);
+  for (t=0;t<started;t++)
+    pthread_join(thread[t],NULL);
+
+  for (t=0;t<p.nq;t++) {
+    pthread_mutex_destroy(&p.q[t].lock);
+    free(p.q[t].job);
+  }
+  free(p.q);
+  free(order);
+  free(sizes);
+}
+#undef MAX_THREADS
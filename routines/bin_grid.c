@@ -0,0 +1,418 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Bins for the streaming modes of the tools. A value with reference
+  coordinate t is counted in bin floor(t), which may be negative, and the
+  grid grows in whatever direction the data need. Each bin counts its
+  entries and, if asked for, sums up a value and its square.
+  The tools compute their bin as (long)(t+offset), where the offset only
+  becomes known once all data are read. For t a tiny bit below an integer
+  the addition can round up into the next bin, depending on the size of
+  the offset. Such values are kept apart together with the smallest binary
+  exponent of t+offset at which this happens, and bin_grid_finish moves
+  them to the bin the tool would have chosen. The tools also merge the
+  bins past their last one into it, and truncation puts values just
+  below the lowest bin into it; bin_grid_finish does that as well.
+  The sums of a bin are added up in the order the values came, like the
+  loops over a whole series do, and the rounding error of every addition
+  is kept as well (Neumaier's compensated summation). A bin that gets
+  edge values or other bins added takes these errors into account, so
+  its sums are as close to the exact ones as double allows. The loops
+  over a whole series add such values in their order instead, which may
+  differ from that in the last digit. All other bins get exactly the
+  sums of the loops. The memory needed only grows with the number of
+  bins, never with the length of the data. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include "tsa.h"
+
+/* values further than this below the next integer never round up */
+#define EDGE_DISTANCE 0x1p-20
+#define NO_EDGE 127
+
+struct edge_value {
+  long k[2];
+  signed char e[2];     /* exponent from which t+offset rounds up */
+  unsigned long count;
+  double sum,sumsq,csum,csumsq;
+  long to[2];           /* the bin it goes to, set by bin_grid_finish */
+};
+
+struct bin_grid *make_bin_grid(unsigned int dim,char sums)
+{
+  struct bin_grid *g;
+
+  check_alloc(g=(struct bin_grid*)calloc((size_t)1,sizeof(struct bin_grid)));
+  g->dim=dim;
+  g->sums=sums;
+
+  return g;
+}
+
+void free_bin_grid(struct bin_grid *g)
+{
+  if (g->count != NULL) free(g->count);
+  if (g->sum != NULL) free(g->sum);
+  if (g->sumsq != NULL) free(g->sumsq);
+  if (g->csum != NULL) free(g->csum);
+  if (g->csumsq != NULL) free(g->csumsq);
+  if (g->edge != NULL) free(g->edge);
+  if (g->hash != NULL) free(g->hash);
+  free(g);
+}
+
+/* returns the position of bin k in the arrays or -1 if it isn't held */
+long bin_grid_index(struct bin_grid *g,long *k)
+{
+  unsigned int d;
+  long pos=0;
+
+  for (d=0;d<g->dim;d++) {
+    if ((k[d] < g->lo[d]) || (k[d] >= g->lo[d]+(long)g->n[d]))
+      return -1;
+    pos=pos*(long)g->n[d]+(k[d]-g->lo[d]);
+  }
+  return pos;
+}
+
+/* a copy of the array x of the old grid at its place in the new one */
+static double *move_sums(struct bin_grid *g,double *x,long *from,
+			 unsigned long n1,unsigned long size)
+{
+  double *y;
+  long i,j,hn1=(g->dim > 1) ? (long)g->n[1] : 1;
+
+  check_alloc(y=(double*)calloc((size_t)size,sizeof(double)));
+  if (x != NULL) {
+    for (i=0;i<(long)g->n[0];i++)
+      for (j=0;j<hn1;j++)
+	y[(i+from[0])*(long)n1+j+from[1]]=x[i*hn1+j];
+    free(x);
+  }
+  return y;
+}
+
+static void grow(struct bin_grid *g,long *k)
+{
+  unsigned int d;
+  long lo[2],hi[2],from[2],i,j,hn1;
+  unsigned long n[2],size;
+  unsigned long *count;
+
+  for (d=0;d<2;d++) {
+    if (d >= g->dim) {
+      lo[d]=0;
+      n[d]=1;
+      continue;
+    }
+    if (g->n[d] == 0) {
+      lo[d]=k[d];
+      n[d]=1;
+      continue;
+    }
+    lo[d]=g->lo[d];
+    hi[d]=g->lo[d]+(long)g->n[d];
+    /* at least double the bins on the side that is too short */
+    if (k[d] < lo[d]) {
+      lo[d]=g->lo[d]-(long)g->n[d];
+      if (k[d] < lo[d])
+	lo[d]=k[d];
+    }
+    else if (k[d] >= hi[d]) {
+      hi[d]=hi[d]+(long)g->n[d];
+      if (k[d] >= hi[d])
+	hi[d]=k[d]+1;
+    }
+    n[d]=(unsigned long)(hi[d]-lo[d]);
+  }
+
+  size=n[0]*n[1];
+  for (d=0;d<2;d++)
+    from[d]=(d < g->dim) ? g->lo[d]-lo[d] : 0;
+  check_alloc(count=(unsigned long*)calloc((size_t)size,
+					   sizeof(unsigned long)));
+  if (g->count != NULL) {
+    hn1=(g->dim > 1) ? (long)g->n[1] : 1;
+    for (i=0;i<(long)g->n[0];i++)
+      for (j=0;j<hn1;j++)
+	count[(i+from[0])*(long)n[1]+j+from[1]]=g->count[i*hn1+j];
+    free(g->count);
+  }
+  if (g->sums) {
+    g->sum=move_sums(g,g->sum,from,n[1],size);
+    g->sumsq=move_sums(g,g->sumsq,from,n[1],size);
+    g->csum=move_sums(g,g->csum,from,n[1],size);
+    g->csumsq=move_sums(g,g->csumsq,from,n[1],size);
+  }
+  g->count=count;
+  for (d=0;d<g->dim;d++) {
+    g->lo[d]=lo[d];
+    g->n[d]=n[d];
+  }
+}
+
+/* adds x to the sum s, and its rounding error to the error c */
+static void add_compensated(double *s,double *c,double x)
+{
+  double t= *s+x;
+
+  if (fabs(*s) >= fabs(x))
+    *c += (*s-t)+x;
+  else
+    *c += (x-t)+*s;
+  *s=t;
+}
+
+/* the place of bin k, which is added if it isn't held yet */
+static long bin_place(struct bin_grid *g,long *k)
+{
+  long pos;
+
+  if ((pos=bin_grid_index(g,k)) < 0) {
+    grow(g,k);
+    pos=bin_grid_index(g,k);
+  }
+  return pos;
+}
+
+/* smallest exponent of t+offset at which t rounds up to k+1+offset */
+static signed char edge_exponent(double t,long k)
+{
+  double d=(double)(k+1)-t,m;
+  int e;
+
+  if (d > EDGE_DISTANCE)
+    return NO_EDGE;
+  m=frexp(d,&e);
+  /* half an ulp of t+offset is 2^(E-53), ties go to the even integer */
+  return (signed char)(53+((m == 0.5) ? e-1 : e));
+}
+
+static unsigned long edge_hash(struct edge_value *v)
+{
+  unsigned long h;
+
+  h=(unsigned long)v->k[0]*0x9e3779b97f4a7c15UL;
+  h^=(unsigned long)v->k[1]+0x7f4a7c159e3779b9UL+(h<<6)+(h>>2);
+  h^=((unsigned long)(unsigned char)v->e[0]<<8)|
+    (unsigned long)(unsigned char)v->e[1];
+  return h*0xbf58476d1ce4e5b9UL;
+}
+
+static void add_edge(struct bin_grid *g,struct edge_value *v,double y)
+{
+  unsigned long i,h,mask;
+  struct edge_value *w;
+
+  if (2*(g->nedge+1) > g->hash_size) {
+    g->hash_size=(g->hash_size == 0) ? 64 : 2*g->hash_size;
+    if (g->hash != NULL)
+      free(g->hash);
+    check_alloc(g->hash=(unsigned long*)malloc(sizeof(unsigned long)*
+					       g->hash_size));
+    check_alloc(g->edge=(struct edge_value*)
+		realloc(g->edge,sizeof(struct edge_value)*g->hash_size/2));
+    mask=g->hash_size-1;
+    for (i=0;i<g->hash_size;i++)
+      g->hash[i]=ULONG_MAX;
+    for (i=0;i<g->nedge;i++) {
+      for (h=edge_hash(&g->edge[i])&mask;g->hash[h] != ULONG_MAX;
+	   h=(h+1)&mask);
+      g->hash[h]=i;
+    }
+  }
+
+  mask=g->hash_size-1;
+  for (h=edge_hash(v)&mask;g->hash[h] != ULONG_MAX;h=(h+1)&mask) {
+    w= &g->edge[g->hash[h]];
+    if ((w->k[0] == v->k[0]) && (w->k[1] == v->k[1]) &&
+	(w->e[0] == v->e[0]) && (w->e[1] == v->e[1]))
+      break;
+  }
+  if (g->hash[h] == ULONG_MAX) {
+    g->hash[h]=g->nedge;
+    w= &g->edge[g->nedge++];
+    *w= *v;
+    w->count=0;
+    w->sum=w->sumsq=w->csum=w->csumsq=0.0;
+  }
+  w->count++;
+  if (g->sums) {
+    add_compensated(&w->sum,&w->csum,y);
+    add_compensated(&w->sumsq,&w->csumsq,pow(y,2));
+  }
+}
+
+/* counts an entry with reference coordinates t[0..dim-1] and adds y to
+   the sums if there are some */
+void bin_grid_add(struct bin_grid *g,double *t,double y)
+{
+  unsigned int d;
+  char edge=0;
+  long pos;
+  struct edge_value v;
+
+  v.k[1]=0;
+  v.e[1]=NO_EDGE;
+  for (d=0;d<g->dim;d++) {
+    v.k[d]=(long)floor(t[d]);
+    if ((v.e[d]=edge_exponent(t[d],v.k[d])) != NO_EDGE)
+      edge=1;
+  }
+  if (edge) {
+    add_edge(g,&v,y);
+    return;
+  }
+  pos=bin_place(g,v.k);
+  g->count[pos]++;
+  if (g->sums) {
+    add_compensated(&g->sum[pos],&g->csum[pos],y);
+    add_compensated(&g->sumsq[pos],&g->csumsq[pos],pow(y,2));
+  }
+}
+
+/* binary exponent of the integer part of t+offset */
+static int band(long k)
+{
+  int e=0;
+
+  if (k < 1)
+    return -1;
+  while (k >>= 1)
+    e++;
+  return e;
+}
+
+/* the bin k goes to, with bins merged as the tool does with fold[d]
+   bins per dimension */
+static void fold_bin(struct bin_grid *g,long *k,long *offset,long *fold,
+		     long *to)
+{
+  unsigned int d;
+
+  to[1]=k[1];
+  for (d=0;d<g->dim;d++) {
+    to[d]=k[d];
+    if (fold == NULL)
+      continue;
+    if (to[d]+offset[d] >= fold[d])
+      to[d]=fold[d]-1-offset[d];
+    if (to[d]+offset[d] < 0)
+      to[d]= -offset[d];
+  }
+}
+
+/* adds count entries with compensated sums to the bin at pos */
+static void merge_into(struct bin_grid *g,long pos,unsigned long count,
+		       double sum,double csum,double sumsq,double csumsq)
+{
+  g->count[pos] += count;
+  if (!g->sums)
+    return;
+  add_compensated(&g->sum[pos],&g->csum[pos],sum);
+  g->csum[pos] += csum;
+  add_compensated(&g->sumsq[pos],&g->csumsq[pos],sumsq);
+  g->csumsq[pos] += csumsq;
+}
+
+/* puts the values kept apart into the bins a tool with these offsets
+   would have put them, afterwards bin k belongs to the tool's k+offset.
+   If fold is not NULL, the tool has fold[d] bins per dimension and merges
+   the ones outside into the first and the last one, so do the same. */
+void bin_grid_finish(struct bin_grid *g,long *offset,long *fold)
+{
+  unsigned int d;
+  unsigned long i,size;
+  long k[2],to[2],pos,tpos,hn1;
+  struct edge_value *v;
+  char *merged;
+
+  /* first make room for every bin something goes to */
+  for (i=0;i<g->nedge;i++) {
+    v= &g->edge[i];
+    v->to[1]=0;
+    for (d=0;d<g->dim;d++) {
+      v->to[d]=v->k[d];
+      if ((v->e[d] != NO_EDGE) && (band(v->k[d]+offset[d]) >= v->e[d]))
+	v->to[d]++;
+    }
+    fold_bin(g,v->to,offset,fold,v->to);
+    bin_place(g,v->to);
+  }
+  hn1=(g->dim > 1) ? (long)g->n[1] : 1;
+  size=g->n[0]*(unsigned long)hn1;
+  if (fold != NULL)
+    for (pos=0;pos<(long)size;pos++) {
+      k[0]=g->lo[0]+pos/hn1;
+      k[1]=(g->dim > 1) ? g->lo[1]+pos%hn1 : 0;
+      fold_bin(g,k,offset,fold,to);
+      if ((g->count[pos] > 0) && (bin_grid_index(g,to) < 0)) {
+	/* the grid moves, start again */
+	grow(g,to);
+	hn1=(g->dim > 1) ? (long)g->n[1] : 1;
+	size=g->n[0]*(unsigned long)hn1;
+	pos= -1;
+      }
+    }
+
+  check_alloc(merged=(char*)calloc((size_t)size+1,(size_t)1));
+  for (i=0;i<g->nedge;i++) {
+    v= &g->edge[i];
+    pos=bin_grid_index(g,v->to);
+    merge_into(g,pos,v->count,v->sum,v->csum,v->sumsq,v->csumsq);
+    merged[pos]=1;
+  }
+  if (fold != NULL)
+    for (pos=0;pos<(long)size;pos++) {
+      if (g->count[pos] == 0)
+	continue;
+      k[0]=g->lo[0]+pos/hn1;
+      k[1]=(g->dim > 1) ? g->lo[1]+pos%hn1 : 0;
+      fold_bin(g,k,offset,fold,to);
+      if ((to[0] == k[0]) && (to[1] == k[1]))
+	continue;
+      tpos=bin_grid_index(g,to);
+      if (g->sums) {
+	merge_into(g,tpos,g->count[pos],g->sum[pos],g->csum[pos],
+		   g->sumsq[pos],g->csumsq[pos]);
+	g->sum[pos]=g->sumsq[pos]=g->csum[pos]=g->csumsq[pos]=0.0;
+      }
+      else
+	g->count[tpos] += g->count[pos];
+      g->count[pos]=0;
+      merged[tpos]=1;
+    }
+  /* only where something was added the errors are used */
+  if (g->sums)
+    for (pos=0;pos<(long)size;pos++)
+      if (merged[pos]) {
+	g->sum[pos] += g->csum[pos];
+	g->sumsq[pos] += g->csumsq[pos];
+      }
+  free(merged);
+
+  g->nedge=0;
+  if (g->hash != NULL)
+    for (i=0;i<g->hash_size;i++)
+      g->hash[i]=ULONG_MAX;
+}
+#undef EDGE_DISTANCE
+#undef NO_EDGE
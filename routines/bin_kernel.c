@@ -0,0 +1,297 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: The 1d binning loop of histogram, binning and negentropy. The
+  bin of x is (long)((x-min)*base/interval+offset), and every value
+  lands in the same bin as it always did. Blocks of values are mapped
+  to bins with AVX-512, AVX2 or SSE2 where the processor has them. The
+  AVX versions multiply by the reciprocal of the interval and only divide
+  when a value comes close to a bin edge, where the two could disagree.
+  Indices are first limited to [-1,range+1] in floating point, so they
+  fit into 32 bits, and then moved to their bin as struct bin_scale's
+  edge says. For few bins bin_count counts into NSUB interleaved copies
+  of the bins, value i into copy i%NSUB, so runs of equal bins don't wait
+  for each other's stores, and adds them up at the end. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "tsa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  defined(__SSE2__)
+#define HAVE_SSE2_BINS
+#include <immintrin.h>
+#endif
+
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+
+#define BLOCK 512
+#define NSUB 4
+#define AHEAD 16
+#define SUB_MAX (1UL<<12)
+#define EDGE_EPS 0x1p-44
+
+/* (x-min)*base/interval+offset limited to [-1,range+1], NaN gives -1 */
+static void raw_scalar(double *x,unsigned long n,struct bin_scale *s,int *t)
+{
+  unsigned long i;
+  double v,hi=(double)s->range+1.0;
+
+  for (i=0;i<n;i++) {
+    v=(x[i]-s->min)*s->base/s->interval+s->offset;
+    if (!(v > -1.0))
+      t[i]= -1;
+    else if (v >= hi)
+      t[i]=(int)s->range+1;
+    else
+      t[i]=(int)v;
+  }
+}
+
+#ifdef HAVE_SSE2_BINS
+/* max returns its second operand if the first is NaN */
+static void raw_sse2(double *x,unsigned long n,struct bin_scale *s,int *t)
+{
+  __m128d v,min=_mm_set1_pd(s->min),base=_mm_set1_pd(s->base);
+  __m128d interval=_mm_set1_pd(s->interval),offset=_mm_set1_pd(s->offset);
+  __m128d lo=_mm_set1_pd(-1.0),hi=_mm_set1_pd((double)s->range+1.0);
+  unsigned long i;
+
+  for (i=0;i+2 <= n;i += 2) {
+    v=_mm_loadu_pd(x+i);
+    v=_mm_add_pd(_mm_div_pd(_mm_mul_pd(_mm_sub_pd(v,min),base),interval),
+		 offset);
+    v=_mm_min_pd(_mm_max_pd(v,lo),hi);
+    _mm_storel_epi64((__m128i*)(t+i),_mm_cvttpd_epi32(v));
+  }
+  raw_scalar(x+i,n-i,s,t+i);
+}
+
+/* v from the reciprocal of the interval, exact unless v lies within tol
+   of an integer, where it could end up on the other side of a bin edge */
+__attribute__((target("avx2")))
+static void raw_avx2(double *x,unsigned long n,struct bin_scale *s,int *t)
+{
+  __m256d a,q,v,f,tol,min=_mm256_set1_pd(s->min),base=_mm256_set1_pd(s->base);
+  __m256d interval=_mm256_set1_pd(s->interval);
+  __m256d inv=_mm256_set1_pd(1.0/s->interval);
+  __m256d offset=_mm256_set1_pd(s->offset),one=_mm256_set1_pd(1.0);
+  __m256d eps=_mm256_set1_pd(EDGE_EPS),sign=_mm256_set1_pd(-0.0);
+  __m256d lo=_mm256_set1_pd(-1.0),hi=_mm256_set1_pd((double)s->range+1.0);
+  unsigned long i;
+
+  for (i=0;i+4 <= n;i += 4) {
+    a=_mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(x+i),min),base);
+    q=_mm256_mul_pd(a,inv);
+    v=_mm256_add_pd(q,offset);
+    f=_mm256_sub_pd(v,_mm256_floor_pd(v));
+    tol=_mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_andnot_pd(sign,q),
+						  _mm256_andnot_pd(sign,v)),
+				    one),eps);
+    if (_mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(f,tol,_CMP_LT_OQ),
+		    _mm256_cmp_pd(_mm256_sub_pd(one,f),tol,_CMP_LT_OQ))))
+      v=_mm256_add_pd(_mm256_div_pd(a,interval),offset);
+    v=_mm256_min_pd(_mm256_max_pd(v,lo),hi);
+    _mm_storeu_si128((__m128i*)(t+i),_mm256_cvttpd_epi32(v));
+  }
+  /* leave no dirty upper halves to the SSE code of the rest */
+  _mm256_zeroupper();
+  raw_scalar(x+i,n-i,s,t+i);
+}
+
+__attribute__((target("avx512f")))
+static void raw_avx512(double *x,unsigned long n,struct bin_scale *s,int *t)
+{
+  __m512d a,q,v,f,tol,min=_mm512_set1_pd(s->min),base=_mm512_set1_pd(s->base);
+  __m512d interval=_mm512_set1_pd(s->interval);
+  __m512d inv=_mm512_set1_pd(1.0/s->interval);
+  __m512d offset=_mm512_set1_pd(s->offset),one=_mm512_set1_pd(1.0);
+  __m512d eps=_mm512_set1_pd(EDGE_EPS);
+  __m512d lo=_mm512_set1_pd(-1.0),hi=_mm512_set1_pd((double)s->range+1.0);
+  unsigned long i;
+
+  for (i=0;i+8 <= n;i += 8) {
+    a=_mm512_mul_pd(_mm512_sub_pd(_mm512_loadu_pd(x+i),min),base);
+    q=_mm512_mul_pd(a,inv);
+    v=_mm512_add_pd(q,offset);
+    f=_mm512_sub_pd(v,_mm512_roundscale_pd(v,_MM_FROUND_TO_NEG_INF|
+					   _MM_FROUND_NO_EXC));
+    tol=_mm512_mul_pd(_mm512_add_pd(_mm512_add_pd(_mm512_abs_pd(q),
+						  _mm512_abs_pd(v)),one),eps);
+    if (_mm512_cmp_pd_mask(f,tol,_CMP_LT_OQ) |
+	_mm512_cmp_pd_mask(_mm512_sub_pd(one,f),tol,_CMP_LT_OQ))
+      v=_mm512_add_pd(_mm512_div_pd(a,interval),offset);
+    v=_mm512_min_pd(_mm512_max_pd(v,lo),hi);
+    _mm256_storeu_si256((__m256i*)(t+i),_mm512_cvttpd_epi32(v));
+  }
+  _mm256_zeroupper();
+  raw_scalar(x+i,n-i,s,t+i);
+}
+#endif
+
+typedef void (*raw_function)(double *,unsigned long,struct bin_scale *,int *);
+
+static raw_function raw_kernel(void)
+{
+#ifdef HAVE_SSE2_BINS
+  if (__builtin_cpu_supports("avx512f"))
+    return raw_avx512;
+  if (__builtin_cpu_supports("avx2"))
+    return raw_avx2;
+  return raw_sse2;
+#else
+  return raw_scalar;
+#endif
+}
+
+/* the bins of -1, range and range+1 for the edge rule of s, range if
+   the value isn't counted */
+static void edge_bins(struct bin_scale *s,unsigned long *below,
+		      unsigned long *at,unsigned long *above)
+{
+  *below= *at= *above=s->range;
+  if (s->edge == BIN_FOLD)
+    *at=s->range-1;
+  else if (s->edge == BIN_CLAMP)
+    *below= *at= *above=s->range-1;
+}
+
+/* bins too many for 32 bit indices, value by value */
+static unsigned long wide_index(double x,struct bin_scale *s)
+{
+  long j;
+
+  j=(long)((x-s->min)*s->base/s->interval+s->offset);
+  if ((unsigned long)j < s->range)
+    return (unsigned long)j;
+  if ((s->edge == BIN_CLAMP) || ((s->edge == BIN_FOLD) &&
+				 ((unsigned long)j == s->range)))
+    return s->range-1;
+  return s->range;
+}
+
+/* the bin of each of the n values, range for those that aren't counted */
+void bin_indices(double *x,unsigned long n,struct bin_scale *s,
+		 unsigned long *j)
+{
+  int t[BLOCK];
+  unsigned long i,m,len,below,at,above;
+  raw_function raw;
+
+  if (s->range == 0)
+    return;
+  if (s->range >= (unsigned long)INT_MAX-1) {
+    for (i=0;i<n;i++)
+      j[i]=wide_index(x[i],s);
+    return;
+  }
+  edge_bins(s,&below,&at,&above);
+  raw=raw_kernel();
+  for (i=0;i<n;i += len) {
+    len=(n-i < BLOCK) ? n-i : BLOCK;
+    raw(x+i,len,s,t);
+    for (m=0;m<len;m++) {
+      if (!(m&3))
+	PREFETCH(x+i+BLOCK+2*m);
+      if ((unsigned int)t[m] < s->range)
+	j[i+m]=(unsigned long)t[m];
+      else
+	j[i+m]=(t[m] < 0) ? below : ((unsigned long)t[m] == s->range) ?
+	  at : above;
+    }
+  }
+}
+
+/* adds the number of values in each bin to box */
+void bin_count(double *x,unsigned long n,struct bin_scale *s,long *box)
+{
+  int t[BLOCK];
+  unsigned long *sub,i,m,j,len,below,at,above,row[3];
+  raw_function raw;
+
+  if (s->range == 0)
+    return;
+  if (s->range >= (unsigned long)INT_MAX-1) {
+    for (i=0;i<n;i++)
+      if ((m=wide_index(x[i],s)) < s->range)
+	box[m]++;
+    return;
+  }
+  raw=raw_kernel();
+  if ((s->range > SUB_MAX) || (n < s->range*NSUB)) {
+    edge_bins(s,&below,&at,&above);
+    for (i=0;i<n;i += len) {
+      len=(n-i < BLOCK) ? n-i : BLOCK;
+      raw(x+i,len,s,t);
+      for (m=0;m<len;m++) {
+	if (!(m&3))
+	  PREFETCH(x+i+BLOCK+2*m);
+	/* the bins are known ahead, so their cache misses can overlap */
+	if ((m+AHEAD < len) && ((unsigned int)t[m+AHEAD] < s->range))
+	  PREFETCH(box+t[m+AHEAD]);
+	if ((unsigned int)t[m] < s->range)
+	  box[t[m]]++;
+	else if ((j=(t[m] < 0) ? below : ((unsigned long)t[m] == s->range) ?
+		  at : above) < s->range)
+	  box[j]++;
+      }
+    }
+    return;
+  }
+
+  /* row t+1 for index t, so -1, range and range+1 get rows of their own
+     which are moved to their bins at the end */
+  check_alloc(sub=(unsigned long*)calloc((size_t)((s->range+3)*NSUB),
+					 sizeof(unsigned long)));
+  for (i=0;i<n;i += len) {
+    len=(n-i < BLOCK) ? n-i : BLOCK;
+    raw(x+i,len,s,t);
+    for (m=0;m+NSUB <= len;m += NSUB) {
+      PREFETCH(x+i+BLOCK+2*m);
+      sub[(t[m]+1)*NSUB]++;
+      sub[(t[m+1]+1)*NSUB+1]++;
+      sub[(t[m+2]+1)*NSUB+2]++;
+      sub[(t[m+3]+1)*NSUB+3]++;
+    }
+    for (;m<len;m++)
+      sub[(t[m]+1)*NSUB]++;
+  }
+  for (i=0;i<s->range+3;i++)
+    sub[i]=sub[i*NSUB]+sub[i*NSUB+1]+sub[i*NSUB+2]+sub[i*NSUB+3];
+  for (i=0;i<s->range;i++)
+    box[i] += (long)sub[i+1];
+  edge_bins(s,&below,&at,&above);
+  row[0]=below;
+  row[1]=at;
+  row[2]=above;
+  for (m=0;m<3;m++)
+    if (row[m] < s->range)
+      box[row[m]] += (long)sub[m ? s->range+m : 0];
+  free(sub);
+}
+#undef BLOCK
+#undef NSUB
+#undef AHEAD
+#undef SUB_MAX
+#undef EDGE_EPS
+#undef PREFETCH
@@ -0,0 +1,248 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Binary column files as written by text2bin. The header is followed
+  by the column names and then by the columns, one after the other, as
+  doubles in the byte order of the writer. If BINARY_HAS_STATS is set,
+  a column_stats for each column follows the columns. The readers hand
+  out pointers right into the mapped file, also for the other array
+  files of array_files.c, so such series have to be given back with
+  free_series or free_multi_series, never with free. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#define BYTE_ORDER_MARK 0x01020304U
+
+/* every mapping that still has columns handed out */
+struct mapping {
+  char *data;
+  unsigned long size,users;
+  struct mapping *next;
+};
+static struct mapping *mappings=NULL;
+static pthread_mutex_t mappings_lock=PTHREAD_MUTEX_INITIALIZER;
+
+int is_binary_file(char *data,unsigned long size)
+{
+  return (size >= sizeof(struct binary_header)) &&
+    !memcmp(data,BINARY_MAGIC,(size_t)8);
+}
+
+static void bad_binary(char *name,char *why)
+{
+  fprintf(stderr,"%s is not a valid binary column file: %s. Exiting!\n",
+	  (name == NULL) ? "input" : name,why);
+  exit(BINARY_COLUMNS_WRONG_FORMAT);
+}
+
+struct binary_header *check_binary_file(char *name,char *data,
+					unsigned long size)
+{
+  struct binary_header *h=(struct binary_header*)data;
+
+  if (h->byteorder != BYTE_ORDER_MARK)
+    bad_binary(name,"written with a different byte order");
+  if ((h->name_size != BINARY_NAME_SIZE) || (h->data%sizeof(double)) ||
+      (h->data > size) ||
+      (h->data < sizeof(struct binary_header)+h->cols*BINARY_NAME_SIZE) ||
+      (h->cols > (size-h->data)/sizeof(double)) ||
+      ((h->cols > 0) && (h->rows > (size-h->data)/sizeof(double)/h->cols)))
+    bad_binary(name,"header does not match the file size");
+  if ((h->flags&BINARY_HAS_STATS) &&
+      (size-h->data-h->cols*h->rows*sizeof(double) <
+       h->cols*sizeof(struct column_stats)))
+    bad_binary(name,"column statistics are missing");
+
+  return h;
+}
+
+/* the requested columns of a mapped array file. Columns of doubles
+   that lie one after the other in the file are handed out in place,
+   the others are copied */
+double **map_array_columns(char *name,char *data,unsigned long size,
+			   struct array_layout *a,unsigned long *l,
+			   unsigned long ex,struct column_plan *plan,
+			   unsigned int verbosity)
+{
+  struct mapping *m;
+  unsigned int i;
+  unsigned long j,rows,users=0;
+  double **x;
+  char *column;
+
+  check_array_columns(name,a,plan);
+  rows=(ex < a->rows) ? a->rows-ex : 0;
+  if (rows > *l)
+    rows= *l;
+  *l=rows;
+  if (verbosity&VER_INPUT)
+    fprintf(stderr,"Mapping %lu rows of %u column(s) from binary file %s\n",
+	    rows,plan->n,(name == NULL) ? "input" : name);
+
+  check_alloc(x=(double**)malloc(sizeof(double*)*plan->n));
+  if (rows == 0) {
+    for (i=0;i<plan->n;i++)
+      x[i]=NULL;
+    unmap_file(data,size);
+    return x;
+  }
+
+  for (i=0;i<plan->n;i++) {
+    column=a->data+(plan->col[i]-1)*a->col_step+ex*a->row_step;
+    /* a column requested twice gets its own copy, the tools may change
+       their series in place */
+    if ((a->size == sizeof(double)) && (a->row_step == sizeof(double)) &&
+	!((unsigned long)column%sizeof(double)) &&
+	!((i > 0) && (plan->col[i] == plan->col[i-1]))) {
+      x[plan->slot[i]]=(double*)column;
+      users++;
+    }
+    else {
+      check_alloc(x[plan->slot[i]]=(double*)malloc(sizeof(double)*rows));
+      for (j=0;j<rows;j++)
+	x[plan->slot[i]][j]=array_element(a,ex+j,plan->col[i]-1);
+    }
+  }
+
+  if (users == 0) {
+    unmap_file(data,size);
+    return x;
+  }
+  check_alloc(m=(struct mapping*)malloc(sizeof(struct mapping)));
+  m->data=data;
+  m->size=size;
+  m->users=users;
+  pthread_mutex_lock(&mappings_lock);
+  m->next=mappings;
+  mappings=m;
+  pthread_mutex_unlock(&mappings_lock);
+
+  return x;
+}
+
+/* looks up the statistics stored with a mapped column.
+   Returns 1 if x is a whole column of a binary file which has them */
+int stored_stats(double *x,unsigned long l,struct column_stats *st)
+{
+  struct mapping *m;
+  struct binary_header *h;
+  double *first;
+  unsigned long col;
+  int found=0;
+
+  pthread_mutex_lock(&mappings_lock);
+  for (m=mappings;m != NULL;m=m->next)
+    if (((char*)x >= m->data) && ((char*)x < m->data+m->size)) {
+      h=(struct binary_header*)m->data;
+      first=(double*)(m->data+h->data);
+      if (is_binary_file(m->data,m->size) && (h->flags&BINARY_HAS_STATS) && (l == h->rows) && (l > 0) &&
+	  !((unsigned long)(x-first)%h->rows)) {
+	col=(unsigned long)((x-first)/h->rows);
+	memcpy(st,(struct column_stats*)(first+h->cols*h->rows)+col,
+	       sizeof(struct column_stats));
+	found=1;
+      }
+      break;
+    }
+  pthread_mutex_unlock(&mappings_lock);
+
+  return found;
+}
+
+void free_series(double *x)
+{
+  struct mapping *m,**prev;
+
+  if (x == NULL)
+    return;
+  pthread_mutex_lock(&mappings_lock);
+  for (prev= &mappings;(m= *prev) != NULL;prev= &m->next)
+    if (((char*)x >= m->data) && ((char*)x < m->data+m->size)) {
+      if (--m->users == 0) {
+	*prev=m->next;
+	unmap_file(m->data,m->size);
+	free(m);
+      }
+      pthread_mutex_unlock(&mappings_lock);
+      return;
+    }
+  pthread_mutex_unlock(&mappings_lock);
+  free(x);
+}
+
+void free_multi_series(double **x,unsigned int dim)
+{
+  unsigned int i;
+
+  for (i=0;i<dim;i++)
+    free_series(x[i]);
+  free(x);
+}
+
+void write_binary_columns(char *name,double **x,unsigned int cols,
+			  unsigned long rows,char **names)
+{
+  struct binary_header h;
+  struct column_stats *st;
+  char cname[BINARY_NAME_SIZE];
+  unsigned int i;
+  unsigned long pos;
+  FILE *fout;
+
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,BINARY_MAGIC,(size_t)8);
+  h.byteorder=BYTE_ORDER_MARK;
+  h.name_size=BINARY_NAME_SIZE;
+  h.cols=cols;
+  h.rows=rows;
+  pos=sizeof(h)+(unsigned long)cols*BINARY_NAME_SIZE;
+  h.data=(pos+63)/64*64;
+  h.flags=BINARY_HAS_STATS;
+
+  test_outfile(name);
+  fout=fopen(name,"wb");
+  fwrite(&h,sizeof(h),(size_t)1,fout);
+  for (i=0;i<cols;i++) {
+    memset(cname,0,(size_t)BINARY_NAME_SIZE);
+    strncpy(cname,names[i],(size_t)BINARY_NAME_SIZE-1);
+    fwrite(cname,(size_t)1,(size_t)BINARY_NAME_SIZE,fout);
+  }
+  for (;pos<h.data;pos++)
+    fputc(0,fout);
+  for (i=0;i<cols;i++)
+    if (fwrite(x[i],sizeof(double),(size_t)rows,fout) != rows) {
+      fprintf(stderr,"Couldn't write to %s. Exiting\n",name);
+      exit(TEST_OUTFILE_NO_WRITE_ACCESS);
+    }
+  /* the same statistics as the columns would get in memory */
+  check_alloc(st=(struct column_stats*)malloc(sizeof(struct column_stats)*
+					      ((cols > 0) ? cols : 1)));
+  column_statistics(x,cols,rows,st);
+  fwrite(st,sizeof(struct column_stats),(size_t)cols,fout);
+  free(st);
+  if (fclose(fout) != 0) {
+    fprintf(stderr,"Couldn't write to %s. Exiting\n",name);
+    exit(TEST_OUTFILE_NO_WRITE_ACCESS);
+  }
+}
+#undef BYTE_ORDER_MARK
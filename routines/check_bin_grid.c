@@ -0,0 +1,134 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Streams values through the bins of binning2d's streaming mode,
+  run by 'make check'. Many of them lie close below a bin edge or
+  beyond the bins the tool keeps, so bin_grid has to keep them apart
+  and move them in bin_grid_finish. Checks that the memory used doesn't
+  grow with the number of values, and that every value is counted and
+  summed up exactly once.
+  Usage: check_bin_grid [number of values [seed]] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/resource.h>
+#include "tsa.h"
+
+#define DEFAULT_COUNT 20000000UL
+#define BINS 50
+/* growth of the peak memory from a tenth of the values to all of them */
+#define MAX_GROWTH_KB 1024L
+
+static unsigned long long state;
+
+/* xorshift64*, so the values are the same on every system */
+static unsigned long long next_random(void)
+{
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state*0x2545f4914f6cdd1dULL;
+}
+
+static double uniform(void)
+{
+  return (double)(next_random() >> 11)*0x1p-53;
+}
+
+/* a reference coordinate, some beyond the bins; with edge set just
+   below a bin edge, as decimal data put their values onto the edges */
+static double coordinate(int edge)
+{
+  double t=uniform()*(BINS+4)-2.0;
+
+  if (edge)
+    t=floor(t)+1.0-ldexp(1.0,-44-(int)(next_random()%4));
+  return t;
+}
+
+static long peak_kb(void)
+{
+  struct rusage r;
+
+  getrusage(RUSAGE_SELF,&r);
+  return r.ru_maxrss;
+}
+
+int main(int argc,char **argv)
+{
+  struct bin_grid *g;
+  double t[2],y;
+  long double sum=0.0L,binned=0.0L;
+  unsigned long i,count=DEFAULT_COUNT,entries=0,pos,size;
+  long warm=0,offset[2]={2,2},fold[2]={BINS,BINS},growth;
+  int edge;
+
+  if (argc > 1)
+    count=strtoul(argv[1],NULL,10);
+  state=(argc > 2) ? strtoull(argv[2],NULL,10) : 0x9e3779b97f4a7c15ULL;
+  if (state == 0)
+    state=1;
+
+  g=make_bin_grid(2,1);
+  for (i=0;i<count;i++) {
+    if (i == count/10)
+      warm=peak_kb();
+    /* an eighth of the values lie on an edge in one dimension */
+    edge=(int)(next_random()&15);
+    t[0]=coordinate(edge == 0);
+    t[1]=coordinate(edge == 1);
+    y=uniform()*4.0-1.0;
+    sum += y;
+    bin_grid_add(g,t,y);
+  }
+  growth=peak_kb()-warm;
+
+  bin_grid_finish(g,offset,fold);
+  size=g->n[0]*g->n[1];
+  for (pos=0;pos<size;pos++) {
+    entries += g->count[pos];
+    binned += g->sum[pos];
+  }
+  free_bin_grid(g);
+
+  if (entries != count) {
+    fprintf(stderr,"check_bin_grid: %lu of %lu values counted\n",entries,
+	    count);
+    fprintf(stderr,"check_bin_grid: FAILED\n");
+    exit(1);
+  }
+  if (fabsl(binned-sum) > 1e-9L*(long double)count) {
+    fprintf(stderr,"check_bin_grid: sum %.17Lg instead of %.17Lg\n",binned,
+	    sum);
+    fprintf(stderr,"check_bin_grid: FAILED\n");
+    exit(1);
+  }
+  if (growth > MAX_GROWTH_KB) {
+    fprintf(stderr,"check_bin_grid: memory grew by %ld kB from %lu to %lu"
+	    " values\n",growth,count/10,count);
+    fprintf(stderr,"check_bin_grid: FAILED\n");
+    exit(1);
+  }
+  fprintf(stderr,"check_bin_grid: %lu values binned, memory grew by %ld kB"
+	  "\n",count,growth);
+  return 0;
+}
+#undef DEFAULT_COUNT
+#undef BINS
+#undef MAX_GROWTH_KB
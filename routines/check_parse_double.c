@@ -0,0 +1,167 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Compares parse_double with strtod on random strings, run by
+  'make check'. The strings are random doubles printed in various
+  formats, random digit strings with long mantissas and extreme
+  exponents, decimals exactly half way between two doubles, and random
+  garbage made of the characters a number may contain. Both have to
+  accept the same strings and give the same bits, and is_number has to
+  tell which ones are accepted.
+  Usage: check_parse_double [number of strings [seed]] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "tsa.h"
+
+#define DEFAULT_COUNT 1000000UL
+#define MAX_ERRORS 10
+
+static unsigned long long state;
+
+/* xorshift64*, so the strings are the same on every system */
+static unsigned long long next_random(void)
+{
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state*0x2545f4914f6cdd1dULL;
+}
+
+static unsigned long below(unsigned long n)
+{
+  return (unsigned long)(next_random()%n);
+}
+
+static double random_double(void)
+{
+  unsigned long long bits=next_random();
+  double x;
+
+  memcpy(&x,&bits,sizeof(double));
+  return x;
+}
+
+static void random_digits(char *s,unsigned long n)
+{
+  unsigned long i;
+
+  for (i=0;i<n;i++)
+    s[i]=(char)('0'+below(10));
+  s[n]='\0';
+}
+
+static void make_string(char *s)
+{
+  static const char garbage[]="0123456789.eE+-xXinfaIN ";
+  char digits[64];
+  unsigned long long w;
+  double x;
+  unsigned long i,n;
+
+  switch (below(8)) {
+  case 0:
+    sprintf(s,"%.17g",random_double());
+    break;
+  case 1:
+    sprintf(s,"%.*e",(int)below(20),random_double());
+    break;
+  case 2:
+    /* short decimals as found in data files */
+    x=(double)(long)(next_random()%2000001)-1000000.0;
+    sprintf(s,"%.*f",(int)below(8),x/pow(10.0,(double)below(8)));
+    break;
+  case 3:
+    /* up to 19 digits and a moderate exponent, the fast paths */
+    random_digits(digits,1+below(19));
+    sprintf(s,"%s%s%se%d",(below(2)) ? "-" : "",(below(4)) ? "" : "0.",
+	    digits,(int)below(700)-350);
+    break;
+  case 4:
+    /* long mantissas and exponents out of range */
+    random_digits(digits,1+below(40));
+    sprintf(s,"%s.%se%d",(below(2)) ? "-0" : "0",digits,
+	    (int)below(1400)-700);
+    break;
+  case 5:
+    /* 2^53 < w < 2^64 odd is half way between two doubles */
+    w=(next_random() >> below(11))|(1ULL << 53)|1ULL;
+    sprintf(s,"%llue%d",w,(int)below(46)-23);
+    break;
+  case 6:
+    /* the double next to a power of ten, with few digits */
+    x=pow(10.0,(double)((int)below(600)-300));
+    x=(below(2)) ? nextafter(x,0.0) : nextafter(x,HUGE_VAL);
+    sprintf(s,"%.*g",1+(int)below(17),x);
+    break;
+  default:
+    n=1+below(24);
+    for (i=0;i<n;i++)
+      s[i]=garbage[below(sizeof(garbage)-1)];
+    s[n]='\0';
+    /* parse_double expects no leading whitespace */
+    if (s[0] == ' ')
+      s[0]='1';
+    break;
+  }
+}
+
+int main(int argc,char **argv)
+{
+  char s[128],*rest;
+  double want,got;
+  unsigned long i,count=DEFAULT_COUNT,errors=0;
+  int wok,gok;
+
+  if (argc > 1)
+    count=strtoul(argv[1],NULL,10);
+  state=(argc > 2) ? strtoull(argv[2],NULL,10) : 0x853c49e6748fea9bULL;
+  if (state == 0)
+    state=1;
+
+  for (i=0;i<count;i++) {
+    make_string(s);
+    want=strtod(s,&rest);
+    wok=(rest != s);
+    got=0.0;
+    gok=parse_double(s,(unsigned long)strlen(s),&got);
+    if ((wok != gok) || (wok && memcmp(&want,&got,sizeof(double)))) {
+      fprintf(stderr,"check_parse_double: '%s': strtod %s %.17g, "
+	      "parse_double %s %.17g\n",s,(wok) ? "accepts" : "rejects",
+	      want,(gok) ? "accepts" : "rejects",got);
+      if (++errors == MAX_ERRORS)
+	break;
+    }
+    if (is_number(s,(unsigned long)strlen(s)) != wok) {
+      fprintf(stderr,"check_parse_double: '%s': strtod %s it, is_number "
+	      "doesn't\n",s,(wok) ? "accepts" : "rejects");
+      if (++errors == MAX_ERRORS)
+	break;
+    }
+  }
+  if (errors) {
+    fprintf(stderr,"check_parse_double: FAILED\n");
+    exit(1);
+  }
+  fprintf(stderr,"check_parse_double: %lu strings converted alike\n",count);
+  return 0;
+}
+#undef DEFAULT_COUNT
+#undef MAX_ERRORS
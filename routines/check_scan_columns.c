@@ -0,0 +1,106 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Checks that scan_columns and scan_indexed_columns reject a line
+  with a field before or at a requested column that is no number, also
+  since the skipped fields are only checked by is_number, and accept
+  the lines that are numbers up to there. Run by 'make check'. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsa.h"
+
+struct line {
+  char *text;
+  unsigned int n,col[3];
+  int ok;
+  double val[3];
+};
+
+static struct line lines[]={
+  {"# 100 200",1,{2},0,{0}},
+  {"#100 200",1,{2},0,{0}},
+  {"4 x 6",1,{3},0,{0}},
+  {"4 x 6",1,{1},1,{4}},
+  {"abc 1",1,{2},0,{0}},
+  {"1 . 2",1,{3},0,{0}},
+  {"1 - 2",1,{3},0,{0}},
+  {"1 +e5 2",1,{3},0,{0}},
+  {"1 e5 2",1,{3},0,{0}},
+  {"1 .e5 2",1,{3},0,{0}},
+  {"1 in 2",1,{3},0,{0}},
+  {"1 na 2",1,{3},0,{0}},
+  {"1 2",1,{3},0,{0}},
+  {"1 2 x",2,{3,1},0,{0}},
+  {"",1,{1},0,{0}},
+  {"  \t ",1,{1},0,{0}},
+  {"1 2 3",1,{3},1,{3}},
+  {".5 -1e3 +7",1,{3},1,{7}},
+  {"-.5e-3 inf 8",1,{3},1,{8}},
+  {"NaN -Infinity 9",1,{3},1,{9}},
+  {"0x1p3 1x 2,5 10",1,{4},1,{10}},
+  {"5e 3. 11",1,{3},1,{11}},
+  {"1 2 3 4",3,{4,2,2},1,{4,2,2}},
+  {"\t1\t\t2 \f 3  ",2,{3,1},1,{3,1}},
+};
+
+static int check(char *how,struct line *l,int ok,double *val)
+{
+  unsigned int i;
+
+  if (ok == l->ok) {
+    for (i=0;ok && (i<l->n);i++)
+      if (val[i] != l->val[i])
+	break;
+    if (!ok || (i == l->n))
+      return 0;
+  }
+  fprintf(stderr,"check_scan_columns: %s %s '%s' column %u\n",how,
+	  (ok) ? "accepts" : "rejects",l->text,l->col[0]);
+  return 1;
+}
+
+int main(void)
+{
+  struct text_index *ix=make_text_index();
+  struct column_plan *plan;
+  unsigned long k,n=sizeof(lines)/sizeof(struct line),errors=0;
+  char *text;
+  double val[3];
+
+  for (k=0;k<n;k++) {
+    plan=make_column_plan(lines[k].col,lines[k].n);
+    check_alloc(text=strdup(lines[k].text));
+    errors += check("scan_columns",&lines[k],
+		    scan_columns(text,text+strlen(text),plan,val),val);
+    index_text(text,(unsigned long)strlen(text),ix);
+    errors += check("scan_indexed_columns",&lines[k],
+		    scan_indexed_columns(ix,0,(unsigned long)strlen(text),
+					 plan,val),val);
+    free(text);
+    free_column_plan(plan);
+  }
+  free_text_index(ix);
+  if (errors) {
+    fprintf(stderr,"check_scan_columns: FAILED\n");
+    exit(1);
+  }
+  fprintf(stderr,"check_scan_columns: %lu lines scanned as expected\n",n);
+  return 0;
+}
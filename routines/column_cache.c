@@ -0,0 +1,401 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Cache of parsed text columns. With TISEAN_CACHE=on the columns
+  of a text file foo.dat are kept in .foo.dat.tscache next to it, as
+  one array of doubles per column and line together with a bit per line
+  telling whether the field and all fields before it were numbers
+  there, as scan_columns requires. A row is made from the cached
+  columns the same way scan_columns would make it, so -c 1,3 and -c 2
+  share one cache. The cache belongs to the size and modification time
+  of foo.dat; if they differ, or a column is missing, the file is
+  parsed again for all columns asked for so far and the cache is
+  replaced, see sidecar.c. Lines that are no number in some cached
+  column are listed with their place in foo.dat, for the messages about
+  ignored lines. If the cache can't be written the columns are used
+  from memory. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsa.h"
+
+#define CACHE_MAGIC "TSCACHE2"
+#define BYTE_ORDER_MARK 0x01020304U
+#define SIZE_STEP 1000
+
+struct cache_header {
+  char magic[8];
+  unsigned int byteorder;
+  unsigned int cols;
+  struct sidecar_key key;           /* of the source */
+  unsigned long long lines,bad;
+};
+
+/* a line that isn't a number in at least one cached column */
+struct bad_line {
+  unsigned long long line,start,len;
+};
+
+struct cache {
+  unsigned int cols;
+  unsigned int *col;                /* sorted column numbers */
+  unsigned long lines;
+  double **val;                     /* per column, one value per line */
+  unsigned long long **valid;       /* per column, one bit per line */
+  struct bad_line *bad;
+  unsigned long nbad;
+};
+
+static unsigned long words(unsigned long lines)
+{
+  return lines/64+1;
+}
+
+static unsigned long column_bytes(unsigned long lines)
+{
+  return sizeof(double)*lines+sizeof(unsigned long long)*words(lines);
+}
+
+static unsigned long header_bytes(unsigned int cols)
+{
+  return (sizeof(struct cache_header)+sizeof(unsigned int)*cols+7)/8*8;
+}
+
+/* points c into a mapped cache if it belongs to key */
+static int load_cache(char *map,unsigned long size,struct sidecar_key *key,
+		      struct cache *c)
+{
+  struct cache_header *h=(struct cache_header*)map;
+  unsigned int i;
+  char *p;
+
+  if ((size < sizeof(struct cache_header)) ||
+      memcmp(h->magic,CACHE_MAGIC,(size_t)8) ||
+      (h->byteorder != BYTE_ORDER_MARK) ||
+      memcmp(&h->key,key,sizeof(struct sidecar_key)) ||
+      (size < header_bytes(h->cols)) ||
+      (h->lines > size/sizeof(double)))
+    return 0;
+  c->cols=h->cols;
+  c->lines=(unsigned long)h->lines;
+  c->nbad=(unsigned long)h->bad;
+  if ((c->nbad > c->lines) ||
+      (size != header_bytes(c->cols)+c->cols*column_bytes(c->lines)+
+       c->nbad*sizeof(struct bad_line)))
+    return 0;
+
+  c->col=(unsigned int*)(map+sizeof(struct cache_header));
+  check_alloc(c->val=(double**)malloc(sizeof(double*)*(c->cols+1)));
+  check_alloc(c->valid=(unsigned long long**)
+	      malloc(sizeof(unsigned long long*)*(c->cols+1)));
+  p=map+header_bytes(c->cols);
+  for (i=0;i<c->cols;i++) {
+    c->val[i]=(double*)p;
+    c->valid[i]=(unsigned long long*)(p+sizeof(double)*c->lines);
+    p += column_bytes(c->lines);
+  }
+  c->bad=(struct bad_line*)p;
+
+  return 1;
+}
+
+/* parses the text for the columns col[0..cols-1], sorted and distinct */
+static void build_cache(char *text,unsigned long size,unsigned int *col,
+			unsigned int cols,struct cache *c)
+{
+  char *p,*end=text+size,*line,*start;
+  unsigned int i,field;
+  unsigned long j,max_lines=SIZE_STEP,max_bad=SIZE_STEP,w;
+  int allok,numbers;
+  double h;
+
+  c->cols=cols;
+  check_alloc(c->col=(unsigned int*)malloc(sizeof(unsigned int)*cols));
+  memcpy(c->col,col,sizeof(unsigned int)*cols);
+  check_alloc(c->val=(double**)malloc(sizeof(double*)*(cols+1)));
+  check_alloc(c->valid=(unsigned long long**)
+	      malloc(sizeof(unsigned long long*)*(cols+1)));
+  for (i=0;i<cols;i++) {
+    check_alloc(c->val[i]=(double*)malloc(sizeof(double)*max_lines));
+    check_alloc(c->valid[i]=(unsigned long long*)
+		calloc((size_t)words(max_lines),sizeof(unsigned long long)));
+  }
+  check_alloc(c->bad=(struct bad_line*)
+	      malloc(sizeof(struct bad_line)*max_bad));
+  c->nbad=0;
+
+  for (j=0,line=text;line < end;j++) {
+    if (j == max_lines) {
+      w=words(max_lines);
+      max_lines *= 2;
+      for (i=0;i<cols;i++) {
+	check_alloc(c->val[i]=(double*)
+		    realloc(c->val[i],sizeof(double)*max_lines));
+	check_alloc(c->valid[i]=(unsigned long long*)
+		    realloc(c->valid[i],
+			    sizeof(unsigned long long)*words(max_lines)));
+	memset(c->valid[i]+w,0,sizeof(unsigned long long)*
+	       (words(max_lines)-w));
+      }
+    }
+    /* the fields as scan_columns finds them, a '\0' ends the line */
+    allok=numbers=1;
+    p=line;
+    for (i=0,field=0;i < cols;) {
+      while ((p < end) && (*p != '\n') && *p &&
+	     ((*p == ' ') || ((unsigned char)(*p-9) < 5)))
+	p++;
+      if ((p == end) || (*p == '\n') || (*p == '\0'))
+	break;
+      start=p;
+      while ((p < end) && *p && (*p != ' ') && ((unsigned char)(*p-9) >= 5))
+	p++;
+      /* a field that isn't a number spoils the columns from here on,
+	 only the cached ones are converted */
+      if (++field < col[i])
+	numbers=numbers && is_number(start,(unsigned long)(p-start));
+      else {
+	if (numbers)
+	  numbers=parse_double(start,(unsigned long)(p-start),&h);
+	if (numbers) {
+	  c->val[i][j]=h;
+	  c->valid[i][j/64] |= 1ULL << (j%64);
+	}
+	else {
+	  c->val[i][j]=0.0;
+	  allok=0;
+	}
+	i++;
+      }
+    }
+    for (;i < cols;i++) {
+      c->val[i][j]=0.0;
+      allok=0;
+    }
+    if ((p=(char*)memchr(p,'\n',(size_t)(end-p))) == NULL)
+      p=end;
+    if (!allok) {
+      if (c->nbad == max_bad) {
+	max_bad *= 2;
+	check_alloc(c->bad=(struct bad_line*)
+		    realloc(c->bad,sizeof(struct bad_line)*max_bad));
+      }
+      c->bad[c->nbad].line=j;
+      c->bad[c->nbad].start=(unsigned long long)(line-text);
+      c->bad[c->nbad].len=(unsigned long long)(p-line);
+      c->nbad++;
+    }
+    line=p+1;
+  }
+  c->lines=j;
+}
+
+static void free_built_cache(struct cache *c)
+{
+  unsigned int i;
+
+  for (i=0;i<c->cols;i++) {
+    free(c->val[i]);
+    free(c->valid[i]);
+  }
+  free(c->col);
+  free(c->bad);
+}
+
+/* returns 0 if the cache couldn't be written */
+static int write_cache(char *cname,struct sidecar_key *key,struct cache *c)
+{
+  struct cache_header h;
+  char *tmp,pad[8]={0};
+  unsigned int i;
+  unsigned long hb;
+  int ok;
+  FILE *fout;
+
+  if ((fout=create_sidecar(cname,&tmp)) == NULL)
+    return 0;
+
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,CACHE_MAGIC,(size_t)8);
+  h.byteorder=BYTE_ORDER_MARK;
+  h.cols=c->cols;
+  h.key= *key;
+  h.lines=c->lines;
+  h.bad=c->nbad;
+  hb=header_bytes(c->cols);
+
+  ok=(fwrite(&h,sizeof(h),(size_t)1,fout) == 1);
+  ok=ok && (fwrite(c->col,sizeof(unsigned int),(size_t)c->cols,fout) ==
+	    c->cols);
+  ok=ok && (fwrite(pad,(size_t)1,hb-sizeof(h)-sizeof(unsigned int)*c->cols,
+		   fout) == hb-sizeof(h)-sizeof(unsigned int)*c->cols);
+  for (i=0;ok && (i<c->cols);i++) {
+    ok=(fwrite(c->val[i],sizeof(double),(size_t)c->lines,fout) == c->lines);
+    ok=ok && (fwrite(c->valid[i],sizeof(unsigned long long),
+		     (size_t)words(c->lines),fout) == words(c->lines));
+  }
+  ok=ok && (fwrite(c->bad,sizeof(struct bad_line),(size_t)c->nbad,fout) ==
+	    c->nbad);
+
+  return finish_sidecar(fout,tmp,cname,ok);
+}
+
+/* hands the rows of the cached columns on like the text reader does,
+   taking only the lines sample_lines asks for */
+static unsigned long serve(struct cache *c,char *text,unsigned long hl,
+			   unsigned long ex,struct column_plan *plan,
+			   row_function put,void *data,char *who,
+			   unsigned int verbosity)
+{
+  unsigned int i,k,*which;
+  unsigned long j,b=0,count=0,cand,nc,stride=sample_stride(),*index=NULL;
+  double *val;
+  int ok;
+
+  check_alloc(which=(unsigned int*)malloc(sizeof(unsigned int)*plan->n));
+  check_alloc(val=(double*)malloc(sizeof(double)*plan->n));
+  for (i=0,k=0;i<plan->n;i++) {
+    while (c->col[k] != plan->col[i])
+      k++;
+    which[i]=k;
+  }
+  nc=(ex < c->lines) ? (c->lines-ex+stride-1)/stride : 0;
+  if (sample_size() > 0)
+    index=sample_indices(nc,sample_size(),&nc);
+
+  for (cand=0;(cand < nc) && (count < hl);cand++) {
+    j=ex+((index != NULL) ? index[cand] : cand)*stride;
+    ok=1;
+    for (i=0;i<plan->n;i++) {
+      k=which[i];
+      if (!((c->valid[k][j/64] >> (j%64))&1ULL)) {
+	ok=0;
+	break;
+      }
+      val[plan->slot[i]]=c->val[k][j];
+    }
+    if (ok) {
+      if ((count == 0) && (who != NULL) && (verbosity&VER_FIRST_LINE))
+	print_first_line(who,val,plan->n);
+      put(val,plan->n,data);
+      count++;
+    }
+    else if (verbosity&VER_INPUT) {
+      while (c->bad[b].line < j)
+	b++;
+      print_ignored(j-ex+1,text+c->bad[b].start,
+		    (unsigned long)c->bad[b].len);
+    }
+  }
+  free(which);
+  free(val);
+  if (index != NULL)
+    free(index);
+
+  return count;
+}
+
+/* whether all columns of plan are in c */
+static int has_columns(struct cache *c,struct column_plan *plan)
+{
+  unsigned int i,k=0;
+
+  for (i=0;i<plan->n;i++) {
+    while ((k < c->cols) && (c->col[k] < plan->col[i]))
+      k++;
+    if ((k == c->cols) || (c->col[k] != plan->col[i]))
+      return 0;
+  }
+  return 1;
+}
+
+/* reads the mapped text file name through its cache if TISEAN_CACHE is
+   on. Returns 0 and leaves everything to the text reader otherwise */
+int read_cached(char *name,char *text,unsigned long size,unsigned long hl,
+		unsigned long ex,struct column_plan *plan,row_function put,
+		void *data,char *who,unsigned int verbosity,
+		unsigned long *count)
+{
+  struct sidecar_key key;
+  struct cache c;
+  char *cname,*cmap;
+  unsigned int i,k,n,*col;
+  unsigned long csize;
+  int loaded=0;
+
+  if (!sidecar_wanted("TISEAN_CACHE") || !sidecar_key(name,&key))
+    return 0;
+  cname=sidecar_name(name,".tscache");
+  if ((cmap=map_file(cname,&csize)) != NULL) {
+    loaded=load_cache(cmap,csize,&key,&c);
+    if (loaded && has_columns(&c,plan)) {
+      if (verbosity&VER_INPUT)
+	fprintf(stderr,"Using the cached columns in %s\n",cname);
+      *count=serve(&c,text,hl,ex,plan,put,data,who,verbosity);
+      free(c.val);
+      free(c.valid);
+      unmap_file(cmap,csize);
+      free(cname);
+      return 1;
+    }
+  }
+
+  if (!loaded) {
+    c.cols=0;
+    c.col=NULL;
+  }
+
+  /* all columns cached so far and the new ones, sorted and distinct */
+  check_alloc(col=(unsigned int*)malloc(sizeof(unsigned int)*
+				       (plan->n+c.cols)));
+  for (i=0,k=0,n=0;(i < plan->n) || (k < c.cols);) {
+    if ((k == c.cols) || ((i < plan->n) && (plan->col[i] <= c.col[k]))) {
+      if ((k < c.cols) && (plan->col[i] == c.col[k]))
+	k++;
+      if ((n == 0) || (col[n-1] != plan->col[i]))
+	col[n++]=plan->col[i];
+      i++;
+    }
+    else
+      col[n++]=c.col[k++];
+  }
+  if (loaded) {
+    free(c.val);
+    free(c.valid);
+  }
+  if (cmap != NULL)
+    unmap_file(cmap,csize);
+
+  build_cache(text,size,col,n,&c);
+  free(col);
+  if (write_cache(cname,&key,&c)) {
+    if (verbosity&VER_INPUT)
+      fprintf(stderr,"Cached %u column(s) of %s in %s\n",c.cols,name,cname);
+  }
+  else if (verbosity&VER_INPUT)
+    fprintf(stderr,"Couldn't write the cache %s\n",cname);
+  *count=serve(&c,text,hl,ex,plan,put,data,who,verbosity);
+  free_built_cache(&c);
+  free(cname);
+
+  return 1;
+}
+#undef CACHE_MAGIC
+#undef BYTE_ORDER_MARK
+#undef SIZE_STEP
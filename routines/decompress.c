@@ -0,0 +1,461 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Reads gzip, xz and zstd compressed files, recognised by their
+  magic bytes. A background thread decompresses the mapped file into a
+  queue of UNPACK_DEPTH blocks, which decompress_read hands out in order,
+  so decompression runs while the parser threads work on the blocks
+  before. xz files written in blocks are decompressed by liblzma's
+  threads, zstd files made of several frames of known size by one
+  worker per processor, each decompressing a whole frame into its own
+  block. gzip streams can't be split and use a single thread.
+  Each format is only available if its library was found by configure. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+#include <zlib.h>
+#define HAVE_GZIP
+#endif
+#if defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)
+#include <lzma.h>
+#define HAVE_XZ
+#endif
+#if defined(HAVE_ZSTD_H) && defined(HAVE_LIBZSTD)
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+#define HAVE_ZSTD
+#endif
+
+#define UNPACK_DEPTH 8
+#define UNPACK_BLOCK (1UL<<20)
+#define UNPACK_FRAME_MAX (64UL<<20)
+#define MAX_WORKERS 16
+
+#define PLAIN 0
+#define GZIP 1
+#define XZ 2
+#define ZSTD 3
+
+static char *format_name[]={"plain","gzip","xz","zstd"};
+
+struct decompressor {
+  char *name,*map;
+  unsigned long size;
+  int format;
+  pthread_mutex_t lock;
+  pthread_cond_t filled,emptied;
+  char *block[UNPACK_DEPTH];
+  unsigned long len[UNPACK_DEPTH];
+  char ready[UNPACK_DEPTH];
+  unsigned long next;         /* block the next worker decompresses */
+  unsigned long taken;        /* block decompress_read hands out */
+  unsigned long total;        /* number of blocks, ULONG_MAX until known */
+  unsigned long pos;          /* bytes of block taken handed out */
+  unsigned long *frame;       /* frame offsets for parallel zstd, or NULL */
+  pthread_t worker[MAX_WORKERS];
+  unsigned int workers;
+  char stop;
+};
+
+static int format_of(char *map,unsigned long size)
+{
+  unsigned char *m=(unsigned char*)map;
+
+  if ((size >= 2) && (m[0] == 0x1f) && (m[1] == 0x8b))
+    return GZIP;
+  if ((size >= 6) && !memcmp(m,"\xfd" "7zXZ\0",(size_t)6))
+    return XZ;
+  if ((size >= 4) && (m[0] == 0x28) && (m[1] == 0xb5) && (m[2] == 0x2f) &&
+      (m[3] == 0xfd))
+    return ZSTD;
+  return PLAIN;
+}
+
+static void broken(struct decompressor *d,const char *why)
+{
+  fprintf(stderr,"Decompressing %s failed: %s. Exiting!\n",d->name,why);
+  exit(READ_COLUMNS_READ_FAILED);
+}
+
+/* the number of the next block to decompress, once there is room for it
+   in the queue; 0 if there is nothing left to do */
+static int claim(struct decompressor *d,unsigned long *n)
+{
+  int ok;
+
+  pthread_mutex_lock(&d->lock);
+  *n=d->next++;
+  while (!d->stop && (*n < d->total) && (*n >= d->taken+UNPACK_DEPTH))
+    pthread_cond_wait(&d->emptied,&d->lock);
+  ok=!d->stop && (*n < d->total);
+  pthread_mutex_unlock(&d->lock);
+  return ok;
+}
+
+static void post(struct decompressor *d,unsigned long n,char *buf,
+		 unsigned long len)
+{
+  pthread_mutex_lock(&d->lock);
+  d->block[n%UNPACK_DEPTH]=buf;
+  d->len[n%UNPACK_DEPTH]=len;
+  d->ready[n%UNPACK_DEPTH]=1;
+  pthread_cond_broadcast(&d->filled);
+  pthread_mutex_unlock(&d->lock);
+}
+
+/* block n was the last one */
+static void finish(struct decompressor *d,unsigned long n)
+{
+  pthread_mutex_lock(&d->lock);
+  d->total=n+1;
+  pthread_cond_broadcast(&d->filled);
+  pthread_mutex_unlock(&d->lock);
+}
+
+static unsigned int processors(void)
+{
+  long n=thread_budget();
+
+  if (n < 1)
+    n=1;
+  if (n > MAX_WORKERS)
+    n=MAX_WORKERS;
+  return (unsigned int)n;
+}
+
+#ifdef HAVE_GZIP
+static void *gunzip(void *arg)
+{
+  struct decompressor *d=(struct decompressor*)arg;
+  z_stream z;
+  unsigned long n,in=0,piece;
+  int ret,end=0;
+  char *buf;
+
+  memset(&z,0,sizeof(z));
+  /* 32 lets zlib read the gzip header */
+  if (inflateInit2(&z,15+32) != Z_OK)
+    broken(d,"zlib can't be initialised");
+  while (!end && claim(d,&n)) {
+    check_alloc(buf=(char*)malloc((size_t)UNPACK_BLOCK));
+    z.next_out=(Bytef*)buf;
+    z.avail_out=(uInt)UNPACK_BLOCK;
+    while (z.avail_out > 0) {
+      if (z.avail_in == 0) {
+	piece=d->size-in;
+	if (piece > (1UL<<30))
+	  piece=1UL<<30;
+	z.next_in=(Bytef*)(d->map+in);
+	z.avail_in=(uInt)piece;
+	in += piece;
+      }
+      ret=inflate(&z,Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+	/* gzip files may be several members one after the other */
+	if ((z.avail_in == 0) && (in == d->size)) {
+	  end=1;
+	  break;
+	}
+	inflateReset(&z);
+      }
+      else if (ret == Z_BUF_ERROR)
+	broken(d,"the file is truncated");
+      else if (ret != Z_OK)
+	broken(d,(z.msg != NULL) ? z.msg : "corrupt data");
+    }
+    post(d,n,buf,UNPACK_BLOCK-(unsigned long)z.avail_out);
+    if (end)
+      finish(d,n);
+  }
+  inflateEnd(&z);
+  return NULL;
+}
+#endif
+
+#ifdef HAVE_XZ
+static void *unxz(void *arg)
+{
+  struct decompressor *d=(struct decompressor*)arg;
+  lzma_stream z=LZMA_STREAM_INIT;
+  unsigned long n;
+  lzma_ret ret=LZMA_OK;
+  char *buf;
+#if LZMA_VERSION >= 50040002
+  lzma_mt mt;
+
+  memset(&mt,0,sizeof(mt));
+  mt.flags=LZMA_CONCATENATED;
+  mt.threads=processors();
+  mt.memlimit_threading=lzma_physmem()/4;
+  mt.memlimit_stop=UINT64_MAX;
+  if (lzma_stream_decoder_mt(&z,&mt) != LZMA_OK)
+#else
+  if (lzma_stream_decoder(&z,UINT64_MAX,LZMA_CONCATENATED) != LZMA_OK)
+#endif
+    broken(d,"liblzma can't be initialised");
+  z.next_in=(uint8_t*)d->map;
+  z.avail_in=(size_t)d->size;
+  while ((ret != LZMA_STREAM_END) && claim(d,&n)) {
+    check_alloc(buf=(char*)malloc((size_t)UNPACK_BLOCK));
+    z.next_out=(uint8_t*)buf;
+    z.avail_out=(size_t)UNPACK_BLOCK;
+    while (z.avail_out > 0) {
+      /* all of the input is there, so it can be finished at once */
+      if ((ret=lzma_code(&z,LZMA_FINISH)) == LZMA_STREAM_END)
+	break;
+      if (ret == LZMA_BUF_ERROR)
+	broken(d,"the file is truncated");
+      if (ret != LZMA_OK)
+	broken(d,"corrupt data");
+    }
+    post(d,n,buf,UNPACK_BLOCK-(unsigned long)z.avail_out);
+    if (ret == LZMA_STREAM_END)
+      finish(d,n);
+  }
+  lzma_end(&z);
+  return NULL;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static void *unzstd(void *arg)
+{
+  struct decompressor *d=(struct decompressor*)arg;
+  ZSTD_DCtx *z;
+  ZSTD_inBuffer in;
+  ZSTD_outBuffer out;
+  unsigned long n;
+  size_t ret=1;
+  char *buf;
+
+  if ((z=ZSTD_createDCtx()) == NULL)
+    broken(d,"libzstd can't be initialised");
+  in.src=d->map;
+  in.size=(size_t)d->size;
+  in.pos=0;
+  while (((ret != 0) || (in.pos < in.size)) && claim(d,&n)) {
+    check_alloc(buf=(char*)malloc((size_t)UNPACK_BLOCK));
+    out.dst=buf;
+    out.size=(size_t)UNPACK_BLOCK;
+    out.pos=0;
+    while (out.pos < out.size) {
+      ret=ZSTD_decompressStream(z,&out,&in);
+      if (ZSTD_isError(ret))
+	broken(d,ZSTD_getErrorName(ret));
+      if (in.pos == in.size) {
+	/* ret is 0 at the end of a frame */
+	if (ret == 0)
+	  break;
+	if (out.pos < out.size)
+	  broken(d,"the file is truncated");
+      }
+    }
+    post(d,n,buf,(unsigned long)out.pos);
+    if ((ret == 0) && (in.pos == in.size))
+      finish(d,n);
+  }
+  ZSTD_freeDCtx(z);
+  return NULL;
+}
+
+/* decompresses whole frames, as many at a time as there are workers */
+static void *unzstd_frames(void *arg)
+{
+  struct decompressor *d=(struct decompressor*)arg;
+  ZSTD_DCtx *z;
+  unsigned long n,len;
+  size_t ret;
+  char *buf,*src;
+
+  if ((z=ZSTD_createDCtx()) == NULL)
+    broken(d,"libzstd can't be initialised");
+  while (claim(d,&n)) {
+    src=d->map+d->frame[n];
+    len=(unsigned long)ZSTD_getFrameContentSize(src,
+				(size_t)(d->frame[n+1]-d->frame[n]));
+    check_alloc(buf=(char*)malloc((size_t)((len > 0) ? len : 1)));
+    ret=ZSTD_decompressDCtx(z,buf,(size_t)len,src,
+			    (size_t)(d->frame[n+1]-d->frame[n]));
+    if (ZSTD_isError(ret))
+      broken(d,ZSTD_getErrorName(ret));
+    post(d,n,buf,(unsigned long)ret);
+  }
+  ZSTD_freeDCtx(z);
+  return NULL;
+}
+
+/* the offsets of the frames, if there are several and all of them know
+   how large they are; the number of frames or 0 */
+static unsigned long find_frames(struct decompressor *d)
+{
+  unsigned long off=0,n=0,max=16;
+  unsigned long long content;
+  size_t len;
+
+  check_alloc(d->frame=(unsigned long*)malloc(sizeof(unsigned long)*max));
+  while (off < d->size) {
+    len=ZSTD_findFrameCompressedSize(d->map+off,(size_t)(d->size-off));
+    content=ZSTD_getFrameContentSize(d->map+off,(size_t)(d->size-off));
+    if (ZSTD_isError(len) || (content == ZSTD_CONTENTSIZE_UNKNOWN) ||
+	(content == ZSTD_CONTENTSIZE_ERROR) || (content > UNPACK_FRAME_MAX))
+      break;
+    if (n+1 == max) {
+      max *= 2;
+      check_alloc(d->frame=(unsigned long*)realloc(d->frame,
+					       sizeof(unsigned long)*max));
+    }
+    d->frame[n++]=off;
+    off += (unsigned long)len;
+  }
+  if ((off < d->size) || (n < 2)) {
+    free(d->frame);
+    d->frame=NULL;
+    return 0;
+  }
+  d->frame[n]=off;
+  return n;
+}
+#endif
+
+/* starts decompressing the mapped file if it is compressed, which then
+   belongs to the decompressor; NULL if it isn't */
+struct decompressor *open_decompressor(char *name,char *map,
+				       unsigned long size)
+{
+  struct decompressor *d;
+  void *(*work)(void*)=NULL;
+  unsigned int i,workers=1;
+  int format;
+
+  if ((format=format_of(map,size)) == PLAIN)
+    return NULL;
+
+  check_alloc(d=(struct decompressor*)calloc((size_t)1,
+					     sizeof(struct decompressor)));
+  d->name=name;
+  d->map=map;
+  d->size=size;
+  d->format=format;
+  d->total=ULONG_MAX;
+#ifdef HAVE_GZIP
+  if (format == GZIP)
+    work=gunzip;
+#endif
+#ifdef HAVE_XZ
+  if (format == XZ)
+    work=unxz;
+#endif
+#ifdef HAVE_ZSTD
+  if (format == ZSTD) {
+    unsigned long frames;
+
+    work=unzstd;
+    if ((processors() > 1) && ((frames=find_frames(d)) > 0)) {
+      work=unzstd_frames;
+      d->total=frames;
+      workers=(frames < processors()) ? (unsigned int)frames : processors();
+    }
+  }
+#endif
+  if (work == NULL) {
+    fprintf(stderr,"%s is %s compressed, but support for %s was not "
+	    "built in. Exiting!\n",name,format_name[format],
+	    format_name[format]);
+    exit(READ_COLUMNS_READ_FAILED);
+  }
+
+  pthread_mutex_init(&d->lock,NULL);
+  pthread_cond_init(&d->filled,NULL);
+  pthread_cond_init(&d->emptied,NULL);
+  for (i=0;i<workers;i++) {
+    if (pthread_create(&d->worker[i],NULL,work,d) != 0) {
+      fprintf(stderr,"Couldn't start the decompression thread. Exiting!\n");
+      exit(READ_COLUMNS_READ_FAILED);
+    }
+  }
+  d->workers=workers;
+  return d;
+}
+
+/* copies the next at most want decompressed bytes to dst, returns how
+   many, 0 only at the end */
+unsigned long decompress_read(struct decompressor *d,char *dst,
+			      unsigned long want)
+{
+  unsigned long n,done=0;
+  unsigned int i;
+
+  while (done < want) {
+    i=(unsigned int)(d->taken%UNPACK_DEPTH);
+    pthread_mutex_lock(&d->lock);
+    while (!d->ready[i] && (d->taken < d->total))
+      pthread_cond_wait(&d->filled,&d->lock);
+    pthread_mutex_unlock(&d->lock);
+    if (!d->ready[i])
+      break;
+    n=d->len[i]-d->pos;
+    if (n > want-done)
+      n=want-done;
+    memcpy(dst+done,d->block[i]+d->pos,(size_t)n);
+    done += n;
+    d->pos += n;
+    if (d->pos == d->len[i]) {
+      free(d->block[i]);
+      pthread_mutex_lock(&d->lock);
+      d->ready[i]=0;
+      d->taken++;
+      d->pos=0;
+      pthread_cond_broadcast(&d->emptied);
+      pthread_mutex_unlock(&d->lock);
+    }
+  }
+  return done;
+}
+
+void close_decompressor(struct decompressor *d)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&d->lock);
+  d->stop=1;
+  pthread_cond_broadcast(&d->emptied);
+  pthread_mutex_unlock(&d->lock);
+  for (i=0;i<d->workers;i++)
+    pthread_join(d->worker[i],NULL);
+  for (i=0;i<UNPACK_DEPTH;i++)
+    if (d->ready[i])
+      free(d->block[i]);
+  if (d->frame != NULL)
+    free(d->frame);
+  pthread_mutex_destroy(&d->lock);
+  pthread_cond_destroy(&d->filled);
+  pthread_cond_destroy(&d->emptied);
+  unmap_file(d->map,d->size);
+  free(d);
+}
+#undef UNPACK_DEPTH
+#undef UNPACK_BLOCK
+#undef UNPACK_FRAME_MAX
+#undef MAX_WORKERS
@@ -0,0 +1,137 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Histogram of a stream whose range is not known in advance. The
+  first n values are kept to choose the initial range. Whenever a later
+  value falls outside, the range is doubled towards that value by merging
+  neighbouring pairs of bins, so there are always n bins and the memory
+  doesn't grow with the length of the stream. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include "tsa.h"
+
+struct doubling_bins *make_doubling_bins(unsigned long n)
+{
+  struct doubling_bins *h;
+
+  check_alloc(h=(struct doubling_bins*)malloc(sizeof(struct doubling_bins)));
+  h->n=n;
+  h->lo=h->width=0.0;
+  check_alloc(h->count=(unsigned long*)calloc((size_t)n,
+					      sizeof(unsigned long)));
+  check_alloc(h->first=(double*)malloc(sizeof(double)*n));
+  h->nfirst=0;
+
+  return h;
+}
+
+void free_doubling_bins(struct doubling_bins *h)
+{
+  if (h->first != NULL) free(h->first);
+  free(h->count);
+  free(h);
+}
+
+static void merge_pairs(struct doubling_bins *h,char down)
+{
+  unsigned long i,j;
+  unsigned long *c=h->count;
+
+  if (!down) {
+    for (i=0;i<h->n;i++) {
+      j=i/2;
+      c[j]=(i == 2*j) ? c[i] : c[j]+c[i];
+    }
+    for (i=(h->n+1)/2;i<h->n;i++)
+      c[i]=0;
+  }
+  else {
+    h->lo -= (double)h->n*h->width;
+    for (i=h->n;i-- > 0;) {
+      j=(i+h->n)/2;
+      c[j]=(i+h->n == 2*j+1) ? c[i] : c[j]+c[i];
+    }
+    for (i=0;i<h->n/2;i++)
+      c[i]=0;
+  }
+  h->width *= 2.0;
+}
+
+static void count(struct doubling_bins *h,double x)
+{
+  double t;
+
+  for (;;) {
+    t=floor((x-h->lo)/h->width);
+    if (t < 0.0)
+      merge_pairs(h,1);
+    else if (t >= (double)h->n)
+      merge_pairs(h,0);
+    else
+      break;
+  }
+  h->count[(unsigned long)t]++;
+}
+
+/* the first values span the initial range, the largest one inside */
+static void set_range(struct doubling_bins *h)
+{
+  unsigned long i;
+  double hi;
+
+  h->lo=hi=h->first[0];
+  for (i=1;i<h->nfirst;i++) {
+    if (h->first[i] < h->lo) h->lo=h->first[i];
+    else if (h->first[i] > hi) hi=h->first[i];
+  }
+  h->width=(hi-h->lo)/(double)h->n;
+  if (h->width == 0.0)
+    h->width=((h->lo != 0.0) ? fabs(h->lo) : 1.0)*DBL_EPSILON;
+  while (h->lo+(double)h->n*h->width <= hi)
+    h->width=nextafter(h->width,DBL_MAX);
+
+  for (i=0;i<h->nfirst;i++)
+    count(h,h->first[i]);
+  free(h->first);
+  h->first=NULL;
+}
+
+/* returns 0 if x can't be binned because it's not finite */
+int doubling_bins_add(struct doubling_bins *h,double x)
+{
+  if (!isfinite(x))
+    return 0;
+  if (h->first != NULL) {
+    h->first[h->nfirst++]=x;
+    if (h->nfirst == h->n)
+      set_range(h);
+  }
+  else
+    count(h,x);
+  return 1;
+}
+
+/* sets the range if the stream was shorter than the number of bins */
+void doubling_bins_finish(struct doubling_bins *h)
+{
+  if ((h->first != NULL) && (h->nfirst > 0))
+    set_range(h);
+}
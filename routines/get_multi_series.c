@@ -27,22 +27,20 @@
 #include "tsa.h"
 #include "tisean_cec.h"
 
-#define SIZE_STEP 1000
 extern void check_alloc(void*);
 
-double **get_multi_series(char *name,unsigned long *l,unsigned long ex,
-			  unsigned int *col,char *in_which,char colfix,
-			  unsigned int verbosity)
+/* turns a column string like "3,1,5" into the plan of the columns to read.
+   *col is raised to the number of columns given unless colfix is set,
+   missing columns follow the largest one given */
+struct column_plan *parse_column_string(char *in_which,unsigned int *col,
+					char colfix,unsigned int verbosity)
 {
-  char *input,**format,*which;
+  char *which,*start;
   int i,j;
   unsigned int *hcol,maxcol=0,colcount=0;
-  unsigned long count,max_size=SIZE_STEP,hl,allcount;
-  int input_size=INPUT_SIZE;
-  double **x;
-  FILE *fin;
+  struct column_plan *plan;
 
-  check_alloc(which=(char*)malloc(sizeof(char)*strlen(in_which)));
+  check_alloc(start=which=(char*)malloc(sizeof(char)*(strlen(in_which)+1)));
   for (i=0;i<=strlen(in_which);i++)
     which[i]=in_which[i];
 
@@ -68,7 +66,6 @@ double **get_multi_series(char *name,unsigned long *l,unsigned long ex,
   if (!colfix && (*col < colcount))
     *col=colcount;
 
-  check_alloc(input=(char*)calloc((size_t)input_size,(size_t)1));
   check_alloc(hcol=(unsigned int*)malloc(sizeof(unsigned int)* *col));
   while ((int)(*which) && isspace((unsigned int)(*which)))
     which++;
@@ -100,83 +97,27 @@ double **get_multi_series(char *name,unsigned long *l,unsigned long ex,
     fprintf(stderr,"\n");
   }
 
-  check_alloc(format=(char**)malloc(sizeof(char*)* *col));
-  for (i=0;i< *col;i++) {
-    check_alloc(format[i]=(char*)calloc((size_t)(4*hcol[i]),(size_t)1));
-    strcpy(format[i],"");
-    for (j=1;j<hcol[i];j++)
-      strcat(format[i],"%*lf");
-    strcat(format[i],"%lf");
-  }
+  plan=make_column_plan(hcol,*col);
   free(hcol);
-  
-  check_alloc(x=(double**)malloc(sizeof(double*)* *col));
-  for (i=0;i< *col;i++)
-    check_alloc(x[i]=(double*)malloc(sizeof(double)*max_size));
-  hl= *l;
+  free(start);
 
-  count=0;
-  allcount=0;
-  if (name == NULL) {
-    for (i=0;i<ex;i++)
-      if ((input=myfgets(input,&input_size,stdin,verbosity)) == NULL)
-	break;
-    while ((count < hl) && 
-	   ((input=myfgets(input,&input_size,stdin,verbosity)) != NULL)) {
-      if (count == max_size) {
-	max_size += SIZE_STEP;
-	for (i=0;i< *col;i++)
-	  check_alloc(x[i]=(double*)realloc(x[i],sizeof(double)*max_size));
-      }
-      allcount++;
-      for (i=0;i< *col;i++)
-	if (sscanf(input,format[i],&x[i][count]) != 1) {
-	  if (verbosity&VER_INPUT)
-	    fprintf(stderr,"Line %lu ignored: %s",allcount,input);
-	  break;
-	}
-      if (i == *col)
-	count++;
-    }
-  }
-  else {
-    fin=fopen(name,"r");
-    for (i=0;i<ex;i++)
-      if ((input=myfgets(input,&input_size,fin,verbosity)) == NULL)
-	break;
-    while ((count < hl) && 
-	   ((input=myfgets(input,&input_size,fin,verbosity)) != NULL)) {
-      if (count == max_size) {
-	max_size += SIZE_STEP;
-	for (i=0;i< *col;i++)
-	  check_alloc(x[i]=(double*)realloc(x[i],sizeof(double)*max_size));
-      }
-      allcount++;
-      for (i=0;i< *col;i++)
-	if (sscanf(input,format[i],&x[i][count]) != 1) {
-	  if (verbosity&VER_INPUT)
-	    fprintf(stderr,"Line %lu ignored: %s",allcount,input);
-	  break;
-	}
-      if ((count == 0) && (i == *col) && (verbosity&VER_FIRST_LINE)) {
-	fprintf(stderr,"get_multi_series: first data item(s) used:\n");
-	for (i=0;i< *col;i++)
-	  fprintf(stderr,"%lf ",x[i][0]);
-	fprintf(stderr,"\n");
-      }
-      if (i == *col)
-	count++;
-    }
-    fclose(fin);
-  }
-  
-  for (i=0;i< *col;i++)
-    free(format[i]);
-  free(format);
-  free(input);
+  return plan;
+}
+
+double **get_multi_series(char *name,unsigned long *l,unsigned long ex,
+			  unsigned int *col,char *in_which,char colfix,
+			  unsigned int verbosity)
+{
+  double **x;
+  struct column_plan *plan;
+
+  plan=parse_column_string(in_which,col,colfix,verbosity);
+  x=read_columns(name,l,ex,plan,"get_multi_series",verbosity);
+  free_column_plan(plan);
 
-  *l = count;  
   if (*l == 0) {
+    if (skip_batch_file("0 lines read"))
+      return x;
     fprintf(stderr,"0 lines read. It makes no sense to continue. Exiting!\n");
     exit(GET_MULTI_SERIES_NO_LINES);
   }
@@ -185,10 +126,5 @@ double **get_multi_series(char *name,unsigned long *l,unsigned long ex,
       fprintf(stderr,"Use %lu lines.\n",*l);
   }
 
-  if (max_size > count)
-    for (i=0;i< *col;i++) 
-      check_alloc(x[i]=(double*)realloc(x[i],sizeof(double)*count));
-  
   return x;
 }
-#undef SIZE_STEP
@@ -0,0 +1,238 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Several data files given on the command line are read as one
+  series, one file after the other. search_datafile registers them with
+  set_input_files under the name it returns, and read_columns and
+  stream_columns read all of them when asked for that name. -x and -k
+  are applied to every file, -l and -n to the whole series. -n draws
+  its sample from the lines of all files together, as from the lines of
+  a single file: the lines of each file are counted first, then the
+  sample is drawn and every file reads its part of it.
+  read_input_files parses the files in parallel, one thread per file up
+  to the number of processors, each with the staged reader, and joins
+  the columns afterwards. stream_input_files hands the rows of the files
+  on one file after the other. Lines that are not used are reported
+  with the name of their file. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "tsa.h"
+
+#define MAX_THREADS 16
+
+static char *key=NULL;
+static char **files=NULL;
+static unsigned int nfiles=0;
+/* the file the thread reads, for the messages */
+static _Thread_local char *current=NULL;
+
+struct file_job {
+  unsigned int n,next;
+  unsigned long max,ex;
+  struct column_plan *plan;
+  char *who;
+  unsigned int verbosity;
+  double ***x;
+  unsigned long *l;
+  pthread_mutex_t lock;
+};
+
+void set_input_files(char *name,char **names,unsigned int n)
+{
+  unsigned int i;
+
+  key=name;
+  nfiles=n;
+  check_alloc(files=(char**)malloc(sizeof(char*)*n));
+  for (i=0;i<n;i++) {
+    check_alloc(files[i]=(char*)malloc(strlen(names[i])+1));
+    strcpy(files[i],names[i]);
+  }
+}
+
+/* the files read for name, NULL if it is a single file */
+char **input_files(char *name,unsigned int *n)
+{
+  if ((name == NULL) || (name != key))
+    return NULL;
+  *n=nfiles;
+  return files;
+}
+
+/* the file the calling thread reads if several are read, NULL otherwise */
+char *current_input_file(void)
+{
+  return current;
+}
+
+static void read_file(struct file_job *j,unsigned int f)
+{
+  current=files[f];
+  j->l[f]=j->max;
+  j->x[f]=read_columns(files[f],&j->l[f],j->ex,j->plan,j->who,
+		       j->verbosity);
+  current=NULL;
+}
+
+static void *read_files(void *arg)
+{
+  struct file_job *j=(struct file_job*)arg;
+  unsigned int f;
+
+  for (;;) {
+    pthread_mutex_lock(&j->lock);
+    f=j->next++;
+    pthread_mutex_unlock(&j->lock);
+    if (f >= j->n)
+      return NULL;
+    read_file(j,f);
+  }
+}
+
+/* draws the sample of -n from the lines of all files, every stride-th
+   after the first ex ones, and reads every file's part of it */
+static void read_sample_files(struct file_job *j,unsigned long stride,
+			      unsigned long sample)
+{
+  unsigned int f;
+  unsigned long *lines,*index,total=0,first,kept,r,n;
+
+  check_alloc(lines=(unsigned long*)malloc(sizeof(unsigned long)*nfiles));
+  for (f=0;f<nfiles;f++) {
+    n=count_lines(files[f]);
+    lines[f]=(n > j->ex) ? (n-j->ex+stride-1)/stride : 0;
+    total += lines[f];
+  }
+
+  index=sample_indices(total,sample,&kept);
+  for (f=0,r=0,first=0;f<nfiles;first += lines[f],f++) {
+    for (n=r;(n < kept) && (index[n] < first+lines[f]);n++)
+      index[n] -= first;
+    sample_given(index+r,n-r);
+    read_file(j,f);
+    r=n;
+  }
+  sample_given(NULL,0);
+  free(index);
+  free(lines);
+}
+
+static unsigned int file_threads(unsigned int n)
+{
+  long p=thread_budget();
+
+  if (p < 1)
+    p=1;
+  if (p > MAX_THREADS)
+    p=MAX_THREADS;
+  return ((unsigned long)p < n) ? (unsigned int)p : n;
+}
+
+double **read_input_files(unsigned long *l,unsigned long ex,
+			  struct column_plan *plan,char *who,
+			  unsigned int verbosity)
+{
+  struct file_job j;
+  pthread_t thread[MAX_THREADS];
+  unsigned int i,f,t,nt,started=0;
+  unsigned long r,total=0,sample=sample_size();
+  double **x;
+
+  j.n=nfiles;
+  j.next=0;
+  j.max= *l;
+  j.ex=ex;
+  j.plan=plan;
+  j.who=who;
+  j.verbosity=verbosity;
+  check_alloc(j.x=(double***)malloc(sizeof(double**)*nfiles));
+  check_alloc(j.l=(unsigned long*)malloc(sizeof(unsigned long)*nfiles));
+  if (sample > 0)
+    read_sample_files(&j,sample_stride(),sample);
+  else {
+    pthread_mutex_init(&j.lock,NULL);
+    nt=file_threads(nfiles);
+    for (t=1;t<nt;t++)
+      if (pthread_create(&thread[started],NULL,read_files,&j) == 0)
+	started++;
+    read_files(&j);
+    for (t=0;t<started;t++)
+      pthread_join(thread[t],NULL);
+    pthread_mutex_destroy(&j.lock);
+  }
+
+  for (f=0;f<nfiles;f++)
+    total += j.l[f];
+  if (total > *l)
+    total= *l;
+
+  check_alloc(x=(double**)malloc(sizeof(double*)*plan->n));
+  for (i=0;i<plan->n;i++)
+    check_alloc(x[i]=(double*)malloc(sizeof(double)*((total > 0) ? total : 1)));
+  for (f=0,r=0;(f < nfiles) && (r < total);r += j.l[f],f++) {
+    if (j.l[f] > total-r)
+      j.l[f]=total-r;
+    if (j.l[f] > 0)
+      for (i=0;i<plan->n;i++)
+	memcpy(x[i]+r,j.x[f][i],sizeof(double)*j.l[f]);
+  }
+  for (f=0;f<nfiles;f++)
+    free_multi_series(j.x[f],plan->n);
+  free(j.x);
+  free(j.l);
+
+  *l=total;
+  return x;
+}
+
+unsigned long stream_input_files(unsigned long hl,unsigned long ex,
+				 struct column_plan *plan,row_function put,
+				 void *data,char *who,unsigned int verbosity)
+{
+  unsigned int f,i;
+  unsigned long r,count=0;
+  double **x,*val;
+
+  /* a sample needs all of the rows first */
+  if (sample_size() > 0) {
+    count=hl;
+    x=read_input_files(&count,ex,plan,who,verbosity);
+    check_alloc(val=(double*)malloc(sizeof(double)*plan->n));
+    for (r=0;r<count;r++) {
+      for (i=0;i<plan->n;i++)
+	val[i]=x[i][r];
+      put(val,plan->n,data);
+    }
+    free(val);
+    free_multi_series(x,plan->n);
+    return count;
+  }
+
+  for (f=0;(f < nfiles) && (count < hl);f++) {
+    current=files[f];
+    count += stream_columns(files[f],hl-count,ex,plan,put,data,who,
+			    verbosity);
+    current=NULL;
+  }
+  return count;
+}
+#undef MAX_THREADS
@@ -0,0 +1,154 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Where line ex of a text file starts, for -x. With TISEAN_INDEX=on
+  the offsets of every INDEX_STEP-th line are kept in .foo.dat.tsindex
+  next to foo.dat, see sidecar.c. A lookup starts from the closest
+  known line at or before ex and counts the remaining lines. The index
+  grows as far as lines had to be counted, so skipping the same lines
+  again costs at most INDEX_STEP lines.
+  The split of the rest into blocks in pipeline.c doesn't use the index:
+  it cuts at byte offsets, and only -k needs the line numbers of the
+  blocks, where counting their newlines costs little next to parsing. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsa.h"
+
+#define INDEX_MAGIC "TSINDEX1"
+#define INDEX_STEP 65536UL
+#define BYTE_ORDER_MARK 0x01020304U
+
+struct index_header {
+  char magic[8];
+  unsigned int byteorder,unused;
+  struct sidecar_key key;       /* of the text file */
+  unsigned long long step,entries;
+};
+
+/* the known offsets of lines 0,INDEX_STEP,... from the index, or just
+   that of line 0. Returns their number */
+static unsigned long load_index(char *iname,struct sidecar_key *key,
+				unsigned long long **offset)
+{
+  char *map;
+  unsigned long size,n=1;
+  struct index_header *h;
+
+  if ((map=map_file(iname,&size)) != NULL) {
+    h=(struct index_header*)map;
+    if ((size >= sizeof(struct index_header)) &&
+	!memcmp(h->magic,INDEX_MAGIC,(size_t)8) &&
+	(h->byteorder == BYTE_ORDER_MARK) &&
+	!memcmp(&h->key,key,sizeof(struct sidecar_key)) &&
+	(h->step == INDEX_STEP) && (h->entries > 0) &&
+	(h->entries <= size/sizeof(unsigned long long)) &&
+	(size == sizeof(struct index_header)+
+	 h->entries*sizeof(unsigned long long)))
+      n=(unsigned long)h->entries;
+  }
+  check_alloc(*offset=(unsigned long long*)
+	      malloc(sizeof(unsigned long long)*(n+1)));
+  if (n > 1)
+    memcpy(*offset,map+sizeof(struct index_header),
+	   sizeof(unsigned long long)*n);
+  else
+    (*offset)[0]=0;
+  if (map != NULL)
+    unmap_file(map,size);
+
+  return n;
+}
+
+static int write_index(char *iname,struct sidecar_key *key,
+		       unsigned long long *offset,unsigned long n)
+{
+  struct index_header h;
+  char *tmp;
+  int ok;
+  FILE *fout;
+
+  if ((fout=create_sidecar(iname,&tmp)) == NULL)
+    return 0;
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,INDEX_MAGIC,(size_t)8);
+  h.byteorder=BYTE_ORDER_MARK;
+  h.key= *key;
+  h.step=INDEX_STEP;
+  h.entries=n;
+  ok=(fwrite(&h,sizeof(h),(size_t)1,fout) == 1);
+  ok=ok && (fwrite(offset,sizeof(unsigned long long),(size_t)n,fout) == n);
+
+  return finish_sidecar(fout,tmp,iname,ok);
+}
+
+/* byte offset of line ex of the mapped text file name, size if it has
+   fewer lines */
+unsigned long line_offset(char *name,char *text,unsigned long size,
+			  unsigned long ex,unsigned int verbosity)
+{
+  struct sidecar_key key;
+  unsigned long long *offset=NULL,off=0;
+  unsigned long n=1,known,line=0,max_n;
+  char *iname=NULL,*q;
+  int indexed;
+
+  if (ex == 0)
+    return 0;
+  indexed=sidecar_wanted("TISEAN_INDEX") && sidecar_key(name,&key);
+  if (indexed) {
+    iname=sidecar_name(name,".tsindex");
+    n=load_index(iname,&key,&offset);
+    line=ex/INDEX_STEP;
+    if (line >= n)
+      line=n-1;
+    off=offset[line];
+    line *= INDEX_STEP;
+  }
+  known=max_n=n;
+
+  while ((line < ex) && (off < size)) {
+    if ((q=(char*)memchr(text+off,'\n',(size_t)(size-off))) == NULL)
+      off=size;
+    else
+      off=(unsigned long long)(q-text)+1;
+    line++;
+    if (indexed && (line == n*INDEX_STEP)) {
+      if (n == max_n) {
+	max_n *= 2;
+	check_alloc(offset=(unsigned long long*)
+		    realloc(offset,sizeof(unsigned long long)*(max_n+1)));
+      }
+      offset[n++]=off;
+    }
+  }
+
+  if (indexed) {
+    if ((n > known) && !write_index(iname,&key,offset,n) &&
+	(verbosity&VER_INPUT))
+      fprintf(stderr,"Couldn't write the line index %s\n",iname);
+    free(offset);
+    free(iname);
+  }
+
+  return (off < size) ? (unsigned long)off : size;
+}
+#undef INDEX_MAGIC
+#undef INDEX_STEP
+#undef BYTE_ORDER_MARK
@@ -0,0 +1,152 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Buffered line scanner for streams. Lines are returned as views
+  into a buffer that grows geometrically, so a line of any length is read
+  in linear time. Newlines are found with memchr, and each byte is looked
+  at once. scan_line returns one line with its newline replaced by '\0'.
+  scan_block hands over all complete lines in the buffer at once, by
+  swapping buffers with the caller, for the staged reader. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsa.h"
+
+struct line_scanner *make_line_scanner(FILE *fin,struct uring_reader *u,
+				       struct decompressor *z,
+				       unsigned long size)
+{
+  struct line_scanner *s;
+
+  check_alloc(s=(struct line_scanner*)malloc(sizeof(struct line_scanner)));
+  s->fin=fin;
+  s->uring=u;
+  s->unpack=z;
+  s->size=(size < 2) ? 2 : size;
+  check_alloc(s->buf=(char*)malloc((size_t)s->size));
+  s->start=s->end=s->scanned=0;
+  s->eof=0;
+
+  return s;
+}
+
+void free_line_scanner(struct line_scanner *s)
+{
+  free(s->buf);
+  free(s);
+}
+
+/* reads more, moving the unread part to the front or doubling the buffer
+   if there is no room. One byte is kept free for the '\0' of scan_line */
+static void fill(struct line_scanner *s)
+{
+  unsigned long want,got;
+
+  if (s->start > 0) {
+    memmove(s->buf,s->buf+s->start,(size_t)(s->end-s->start));
+    s->end -= s->start;
+    s->scanned -= s->start;
+    s->start=0;
+  }
+  if (s->end+1 >= s->size) {
+    s->size *= 2;
+    check_alloc(s->buf=(char*)realloc(s->buf,(size_t)s->size));
+  }
+  want=s->size-1-s->end;
+  if (s->uring != NULL)
+    got=uring_read(s->uring,s->buf+s->end,want);
+  else if (s->unpack != NULL)
+    got=decompress_read(s->unpack,s->buf+s->end,want);
+  else
+    got=(unsigned long)fread(s->buf+s->end,(size_t)1,(size_t)want,s->fin);
+  if (got < want)
+    s->eof=1;
+  s->end += got;
+}
+
+/* the next line and its length without the newline, NULL at the end */
+char *scan_line(struct line_scanner *s,unsigned long *len)
+{
+  char *line,*nl;
+
+  for (;;) {
+    if ((nl=(char*)memchr(s->buf+s->scanned,'\n',
+			  (size_t)(s->end-s->scanned))) != NULL) {
+      line=s->buf+s->start;
+      *len=(unsigned long)(nl-line);
+      *nl='\0';
+      s->start=s->scanned=(unsigned long)(nl-s->buf)+1;
+      return line;
+    }
+    s->scanned=s->end;
+    if (s->eof) {
+      if (s->start == s->end)
+	return NULL;
+      /* last line without a newline */
+      line=s->buf+s->start;
+      *len=s->end-s->start;
+      line[*len]='\0';
+      s->start=s->scanned=s->end;
+      return line;
+    }
+    fill(s);
+  }
+}
+
+/* all complete lines that fit into the buffer, with their newlines, or
+   the rest of the input at its end; NULL if there is nothing left.
+   The lines are left in *buf, which is swapped with the scanner's
+   buffer, and stay valid until *buf is passed in again */
+char *scan_block(struct line_scanner *s,char **buf,unsigned long *size,
+		 unsigned long *len)
+{
+  char *block,*p,*h;
+  unsigned long cut,hsize;
+
+  for (;;) {
+    while (!s->eof && (s->end+1 < s->size))
+      fill(s);
+    for (p=s->buf+s->end;(p > s->buf+s->start) && (p[-1] != '\n');p--);
+    if ((p > s->buf+s->start) || s->eof)
+      break;
+    fill(s);
+  }
+  cut=(p > s->buf+s->start) ? (unsigned long)(p-s->buf) : s->end;
+  if (cut == s->start)
+    return NULL;
+
+  if ((*buf == NULL) || (*size < s->size)) {
+    *size=s->size;
+    check_alloc(*buf=(char*)realloc(*buf,(size_t)*size));
+  }
+  memcpy(*buf,s->buf+cut,(size_t)(s->end-cut));
+  block=s->buf+s->start;
+  *len=cut-s->start;
+
+  h=s->buf;
+  hsize=s->size;
+  s->buf= *buf;
+  s->size= *size;
+  s->end -= cut;
+  s->start=s->scanned=0;
+  *buf=h;
+  *size=hsize;
+
+  return block;
+}
@@ -0,0 +1,62 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Regular files are mapped copy-on-write into memory, so that the
+  readers can parse them in place and the tools may even change mapped
+  series without touching the file. Everything else (stdin, pipes, devices) returns
+  NULL and has to be read through stdio. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "tsa.h"
+
+char *map_file(char *name,unsigned long *size)
+{
+  int fd;
+  struct stat st;
+  void *data;
+
+  if (name == NULL)
+    return NULL;
+  if ((fd=open(name,O_RDONLY)) < 0)
+    return NULL;
+  if ((fstat(fd,&st) != 0) || !S_ISREG(st.st_mode) || (st.st_size == 0)) {
+    close(fd);
+    return NULL;
+  }
+  data=mmap(NULL,(size_t)st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+#ifdef MADV_SEQUENTIAL
+  madvise(data,(size_t)st.st_size,MADV_SEQUENTIAL);
+#endif
+
+  *size=(unsigned long)st.st_size;
+  return (char*)data;
+}
+
+void unmap_file(char *data,unsigned long size)
+{
+  munmap((void*)data,(size_t)size);
+}
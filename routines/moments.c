@@ -0,0 +1,357 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Minimum, maximum, mean and variance of the columns of a series
+  in a single pass over the data. The columns are cut into chunks that
+  are spread over one thread per processor. Each chunk is read in blocks
+  small enough to stay in the cache: the minimum, maximum and sum of a
+  block are taken with AVX2 or SSE2 where the processor has them, then
+  the squared deviations from the mean of the block. The blocks, and
+  then the chunks in their order, are merged with the update of Chan,
+  Golub and LeVeque, which doesn't lose precision to the square of the
+  mean like sum(x^2)/n-mean^2 does. The result doesn't depend on the
+  number of threads. Columns with statistics stored in a binary file
+  take those instead, text2bin stores what column_statistics finds.
+  The streaming readers keep a running mean and sum of squared
+  deviations with stats_add, Welford's update, so they are as stable. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  defined(__SSE2__)
+#define HAVE_SSE2_MOMENTS
+#include <immintrin.h>
+#endif
+
+#define MAX_THREADS 64
+#define BLOCK 2048
+/* values of a column a thread takes at a time */
+#define CHUNK (1UL<<18)
+
+struct partial {
+  unsigned long n;
+  double min,max,mean,m2;   /* m2 is the sum of squared deviations */
+};
+
+/* adds the values of b to a */
+static void merge(struct partial *a,struct partial *b)
+{
+  double d;
+  unsigned long n=a->n+b->n;
+
+  if (b->n == 0)
+    return;
+  if (b->min < a->min) a->min=b->min;
+  if (b->max > a->max) a->max=b->max;
+  d=b->mean-a->mean;
+  a->mean += d*((double)b->n/(double)n);
+  a->m2 += b->m2+d*d*((double)a->n*(double)b->n/(double)n);
+  a->n=n;
+}
+
+#ifndef HAVE_SSE2_MOMENTS
+static void block_scalar(double *x,unsigned long n,struct partial *b)
+{
+  unsigned long i;
+  double sum=0.0,d;
+
+  for (i=0;i<n;i++) {
+    if (x[i] < b->min) b->min=x[i];
+    if (x[i] > b->max) b->max=x[i];
+    sum += x[i];
+  }
+  b->mean=sum/(double)n;
+  b->m2=0.0;
+  for (i=0;i<n;i++) {
+    d=x[i]-b->mean;
+    b->m2 += d*d;
+  }
+}
+#endif
+
+#ifdef HAVE_SSE2_MOMENTS
+/* min and max return their second operand if the first is NaN, so NaN
+   is skipped like by the comparisons of block_scalar */
+static void block_sse2(double *x,unsigned long n,struct partial *b)
+{
+  __m128d v,min=_mm_set1_pd(b->min),max=_mm_set1_pd(b->max);
+  __m128d s0=_mm_setzero_pd(),s1=_mm_setzero_pd(),mean;
+  double t[2];
+  unsigned long i,m=n&~3UL;
+
+  for (i=0;i<m;i += 4) {
+    v=_mm_loadu_pd(x+i);
+    min=_mm_min_pd(v,min);
+    max=_mm_max_pd(v,max);
+    s0=_mm_add_pd(s0,v);
+    v=_mm_loadu_pd(x+i+2);
+    min=_mm_min_pd(v,min);
+    max=_mm_max_pd(v,max);
+    s1=_mm_add_pd(s1,v);
+  }
+  _mm_storeu_pd(t,min);
+  b->min=(t[1] < t[0]) ? t[1] : t[0];
+  _mm_storeu_pd(t,max);
+  b->max=(t[1] > t[0]) ? t[1] : t[0];
+  _mm_storeu_pd(t,_mm_add_pd(s0,s1));
+  t[0] += t[1];
+  for (i=m;i<n;i++) {
+    if (x[i] < b->min) b->min=x[i];
+    if (x[i] > b->max) b->max=x[i];
+    t[0] += x[i];
+  }
+  b->mean=t[0]/(double)n;
+
+  mean=_mm_set1_pd(b->mean);
+  s0=s1=_mm_setzero_pd();
+  for (i=0;i<m;i += 4) {
+    v=_mm_sub_pd(_mm_loadu_pd(x+i),mean);
+    s0=_mm_add_pd(s0,_mm_mul_pd(v,v));
+    v=_mm_sub_pd(_mm_loadu_pd(x+i+2),mean);
+    s1=_mm_add_pd(s1,_mm_mul_pd(v,v));
+  }
+  _mm_storeu_pd(t,_mm_add_pd(s0,s1));
+  b->m2=t[0]+t[1];
+  for (i=m;i<n;i++)
+    b->m2 += (x[i]-b->mean)*(x[i]-b->mean);
+}
+
+__attribute__((target("avx2")))
+static void block_avx2(double *x,unsigned long n,struct partial *b)
+{
+  __m256d v,min=_mm256_set1_pd(b->min),max=_mm256_set1_pd(b->max);
+  __m256d s0=_mm256_setzero_pd(),s1=_mm256_setzero_pd(),mean;
+  double t[4];
+  unsigned long i,m=n&~7UL;
+
+  for (i=0;i<m;i += 8) {
+    v=_mm256_loadu_pd(x+i);
+    min=_mm256_min_pd(v,min);
+    max=_mm256_max_pd(v,max);
+    s0=_mm256_add_pd(s0,v);
+    v=_mm256_loadu_pd(x+i+4);
+    min=_mm256_min_pd(v,min);
+    max=_mm256_max_pd(v,max);
+    s1=_mm256_add_pd(s1,v);
+  }
+  _mm256_storeu_pd(t,min);
+  t[0]=(t[1] < t[0]) ? t[1] : t[0];
+  t[2]=(t[3] < t[2]) ? t[3] : t[2];
+  b->min=(t[2] < t[0]) ? t[2] : t[0];
+  _mm256_storeu_pd(t,max);
+  t[0]=(t[1] > t[0]) ? t[1] : t[0];
+  t[2]=(t[3] > t[2]) ? t[3] : t[2];
+  b->max=(t[2] > t[0]) ? t[2] : t[0];
+  _mm256_storeu_pd(t,_mm256_add_pd(s0,s1));
+  t[0]=(t[0]+t[1])+(t[2]+t[3]);
+  for (i=m;i<n;i++) {
+    if (x[i] < b->min) b->min=x[i];
+    if (x[i] > b->max) b->max=x[i];
+    t[0] += x[i];
+  }
+  b->mean=t[0]/(double)n;
+
+  mean=_mm256_set1_pd(b->mean);
+  s0=s1=_mm256_setzero_pd();
+  for (i=0;i<m;i += 8) {
+    v=_mm256_sub_pd(_mm256_loadu_pd(x+i),mean);
+    s0=_mm256_add_pd(s0,_mm256_mul_pd(v,v));
+    v=_mm256_sub_pd(_mm256_loadu_pd(x+i+4),mean);
+    s1=_mm256_add_pd(s1,_mm256_mul_pd(v,v));
+  }
+  _mm256_storeu_pd(t,_mm256_add_pd(s0,s1));
+  /* leave no dirty upper halves to the SSE code of the rest */
+  _mm256_zeroupper();
+  b->m2=(t[0]+t[1])+(t[2]+t[3]);
+  for (i=m;i<n;i++)
+    b->m2 += (x[i]-b->mean)*(x[i]-b->mean);
+}
+#endif
+
+typedef void (*block_function)(double *,unsigned long,struct partial *);
+
+static block_function block_kernel(void)
+{
+#ifdef HAVE_SSE2_MOMENTS
+  if (__builtin_cpu_supports("avx2"))
+    return block_avx2;
+  return block_sse2;
+#else
+  return block_scalar;
+#endif
+}
+
+static void chunk_moments(double *x,unsigned long n,struct partial *p)
+{
+  struct partial b;
+  block_function block=block_kernel();
+  unsigned long i;
+
+  p->n=0;
+  p->min=HUGE_VAL;
+  p->max= -HUGE_VAL;
+  p->mean=p->m2=0.0;
+  for (i=0;i<n;i += b.n) {
+    b.n=(n-i < BLOCK) ? n-i : BLOCK;
+    b.min=HUGE_VAL;
+    b.max= -HUGE_VAL;
+    block(x+i,b.n,&b);
+    merge(p,&b);
+  }
+}
+
+/* the chunks of all columns, taken by the threads in turn */
+struct chunks {
+  double **x;
+  unsigned long n,per,next,total;   /* per column, chunks in all */
+  struct partial *part;
+  pthread_mutex_t lock;
+};
+
+static void *moments_thread(void *arg)
+{
+  struct chunks *c=(struct chunks*)arg;
+  unsigned long k,first;
+
+  for (;;) {
+    pthread_mutex_lock(&c->lock);
+    k=c->next++;
+    pthread_mutex_unlock(&c->lock);
+    if (k >= c->total)
+      return NULL;
+    first=(k%c->per)*CHUNK;
+    if (c->x[k/c->per] != NULL)
+      chunk_moments(c->x[k/c->per]+first,
+		    (c->n-first < CHUNK) ? c->n-first : CHUNK,&c->part[k]);
+    else
+      c->part[k].n=0;
+  }
+}
+
+static unsigned int moments_threads(unsigned long chunks)
+{
+  long t=thread_budget();
+
+  if (t < 1)
+    t=1;
+  if (t > MAX_THREADS)
+    t=MAX_THREADS;
+  return ((unsigned long)t < chunks) ? (unsigned int)t : (unsigned int)chunks;
+}
+
+/* the moments from the statistics of a streaming reader, a binary file
+   or column_statistics */
+void stats_moments(struct column_stats *st,unsigned long l,
+		   struct moments *m)
+{
+  m->min=st->min;
+  m->max=st->max;
+  m->mean=st->mean;
+  m->var=(l > 0) ? st->m2/(double)l : 0.0;
+}
+
+/* the statistics of the first l values of each of the dim columns x */
+void column_statistics(double **x,unsigned int dim,unsigned long l,
+		       struct column_stats *st)
+{
+  struct chunks c;
+  pthread_t thread[MAX_THREADS];
+  unsigned int i,t,nt,started=0;
+  unsigned long k;
+  struct partial all;
+
+  check_alloc(c.x=(double**)malloc(sizeof(double*)*dim));
+  for (i=0;i<dim;i++)
+    c.x[i]=(stored_stats(x[i],l,&st[i])) ? NULL : x[i];
+  c.n=l;
+  c.per=(l+CHUNK-1)/CHUNK;
+  c.total=c.per*dim;
+  c.next=0;
+  check_alloc(c.part=(struct partial*)malloc(sizeof(struct partial)*
+					     (c.total+1)));
+  pthread_mutex_init(&c.lock,NULL);
+
+  /* the calling thread works too */
+  nt=moments_threads(c.total);
+  for (t=1;t<nt;t++)
+    if (pthread_create(&thread[started],NULL,moments_thread,&c) == 0)
+      started++;
+  moments_thread(&c);
+  for (t=0;t<started;t++)
+    pthread_join(thread[t],NULL);
+
+  for (i=0;i<dim;i++) {
+    if (c.x[i] == NULL)
+      continue;
+    all.n=0;
+    all.min=HUGE_VAL;
+    all.max= -HUGE_VAL;
+    all.mean=all.m2=0.0;
+    for (k=0;k<c.per;k++)
+      merge(&all,&c.part[i*c.per+k]);
+    /* the loops this replaces never left a NaN at the start */
+    if ((l > 0) && isnan(x[i][0]))
+      all.min=all.max=x[i][0];
+    st[i].min=all.min;
+    st[i].max=all.max;
+    st[i].mean=all.mean;
+    st[i].m2=all.m2;
+  }
+
+  pthread_mutex_destroy(&c.lock);
+  free(c.part);
+  free(c.x);
+}
+
+/* the moments of the first l values of each of the dim columns x */
+void column_moments(double **x,unsigned int dim,unsigned long l,
+		    struct moments *m)
+{
+  struct column_stats *st;
+  unsigned int i;
+
+  check_alloc(st=(struct column_stats*)malloc(sizeof(struct column_stats)*
+					      dim));
+  column_statistics(x,dim,l,st);
+  for (i=0;i<dim;i++)
+    stats_moments(&st[i],l,&m[i]);
+  free(st);
+}
+
+/* average and standard deviation, like variance; 0 if a file of a
+   batch has no variance, see skip_batch_file */
+int moments_variance(struct moments *m,double *av,double *var)
+{
+  *av=m->mean;
+  *var=sqrt(m->var);
+  if (*var == 0.0) {
+    if (skip_batch_file("variance of the data is zero"))
+      return 0;
+    fprintf(stderr,"Variance of the data is zero. Exiting!\n\n");
+    exit(VARIANCE_VAR_EQ_ZERO);
+  }
+  return 1;
+}
+#undef MAX_THREADS
+#undef BLOCK
+#undef CHUNK
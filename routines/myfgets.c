@@ -23,32 +23,27 @@
 #include <string.h>
 #include "tsa.h"
 
+/* kept for programs outside the library; the readers in routines use
+   the line scanner. The buffer is doubled for long lines and only the
+   newly read part is looked at */
 char* myfgets(char *str,int *size,FILE *fin,unsigned int verbosity)
 {
-  char *ret;
-  char *hstr=NULL;
-  char last;
+  size_t len;
 
-  ret=fgets(str,*size,fin);
-  if (ret == NULL)
+  if (fgets(str,*size,fin) == NULL)
     return NULL;
 
-  last=str[strlen(str)-1];
-
-  while (last != '\n') {
-    *size += INPUT_SIZE;
-    check_alloc(hstr=(char*)calloc((size_t)INPUT_SIZE,(size_t)1));
+  len=strlen(str);
+  while ((len > 0) && (str[len-1] != '\n')) {
+    *size *= 2;
     check_alloc(str=realloc(str,(size_t)*size));
-    ret=fgets(hstr,INPUT_SIZE,fin);
-    strcat(str,hstr);
+    if (fgets(str+len,*size-(int)len,fin) == NULL)
+      /* last line without a newline */
+      return str;
     if (verbosity&VER_INPUT)
       fprintf(stderr,"Line in file too long. Increasing input size\n");
-    last=str[strlen(str)-1];
-    free(hstr);
+    len += strlen(str+len);
   }
 
-  if (ret == NULL)
-    return NULL;
-  else
-    return str;
+  return str;
 }
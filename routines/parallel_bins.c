@@ -0,0 +1,157 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Parallel binning of the histogram programs. parallel_bins splits
+  the n values into one slice per thread and lets a bin_slice function
+  count each slice into a private copy of the bins. The calling thread
+  counts straight into box, so its start values stay. The copies are
+  then added up pairwise in a tree, thread t joining thread t+s and
+  adding its copy for s=1,2,4,..., so log2 of the threads steps merge
+  them. If the copies would need too much memory, there are too few
+  values per thread or just one processor, it bins serially.
+  parallel_bin_count does this for bin_count. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "tsa.h"
+
+#define MAX_THREADS 64
+/* fewest values for a thread of its own */
+#define MIN_SLICE (1UL<<16)
+/* most memory for the private copies of all threads */
+#define MAX_COPIES (1UL<<26)
+
+struct part {
+  struct slicer *s;
+  unsigned int self;
+  long *copy;
+  int started;
+  pthread_t thread;
+};
+
+struct slicer {
+  unsigned long n,nbox;
+  unsigned int nt;
+  bin_slice f;
+  void *data;
+  long *box;
+  struct part part[MAX_THREADS];
+};
+
+static void *bin_part(void *arg)
+{
+  struct part *p=(struct part*)arg,*q;
+  struct slicer *s=p->s;
+  unsigned long i,first,last;
+  unsigned int step;
+
+  if (p->self == 0)
+    p->copy=s->box;
+  else
+    check_alloc(p->copy=(long*)calloc((size_t)s->nbox,sizeof(long)));
+  first=s->n/s->nt*p->self;
+  last=(p->self == s->nt-1) ? s->n : first+s->n/s->nt;
+  s->f(first,last,p->copy,s->data);
+
+  for (step=1;(p->self%(2*step) == 0) && (p->self+step < s->nt);step *= 2) {
+    q= &s->part[p->self+step];
+    /* a thread that couldn't be started does its part here */
+    if (q->started)
+      pthread_join(q->thread,NULL);
+    else
+      bin_part(q);
+    for (i=0;i<s->nbox;i++)
+      p->copy[i] += q->copy[i];
+    free(q->copy);
+  }
+  return NULL;
+}
+
+static unsigned int bin_threads(unsigned long n,unsigned long nbox)
+{
+  long t=thread_budget();
+
+  if (t > MAX_THREADS)
+    t=MAX_THREADS;
+  if ((unsigned long)t > n/MIN_SLICE)
+    t=(long)(n/MIN_SLICE);
+  /* adding up the copies shouldn't take longer than binning */
+  if ((unsigned long)t > n/(2*nbox+1))
+    t=(long)(n/(2*nbox+1));
+  if ((unsigned long)t > MAX_COPIES/sizeof(long)/(nbox+1))
+    t=(long)(MAX_COPIES/sizeof(long)/(nbox+1));
+  return (t < 1) ? 1 : (unsigned int)t;
+}
+
+/* adds the counts of the values 0..n-1 that f puts into nbox bins to
+   box */
+void parallel_bins(unsigned long n,unsigned long nbox,bin_slice f,
+		   void *data,long *box)
+{
+  struct slicer s;
+  unsigned int t;
+
+  s.nt=bin_threads(n,nbox);
+  if (s.nt == 1) {
+    f(0,n,box,data);
+    return;
+  }
+  s.n=n;
+  s.nbox=nbox;
+  s.f=f;
+  s.data=data;
+  s.box=box;
+  for (t=0;t<s.nt;t++) {
+    s.part[t].s= &s;
+    s.part[t].self=t;
+    s.part[t].started=0;
+  }
+  /* from the top down, so a thread only looks at threads that are set up */
+  for (t=s.nt-1;t>0;t--)
+    s.part[t].started=(pthread_create(&s.part[t].thread,NULL,bin_part,
+				      &s.part[t]) == 0);
+  bin_part(&s.part[0]);
+}
+
+struct series_bins {
+  double *x;
+  struct bin_scale *s;
+};
+
+static void count_slice(unsigned long first,unsigned long last,long *box,
+			void *data)
+{
+  struct series_bins *b=(struct series_bins*)data;
+
+  bin_count(b->x+first,last-first,b->s,box);
+}
+
+/* bin_count on all threads */
+void parallel_bin_count(double *x,unsigned long n,struct bin_scale *s,
+			long *box)
+{
+  struct series_bins b;
+
+  b.x=x;
+  b.s=s;
+  parallel_bins(n,s->range,count_slice,&b,box);
+}
+#undef MAX_THREADS
+#undef MIN_SLICE
+#undef MAX_COPIES
@@ -0,0 +1,560 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: The staged reader behind read_columns and stream_columns.
+  A reader thread cuts the input into blocks at line ends; for mapped
+  files it touches the pages of a block so the disk is read ahead, for
+  streams it takes blocks of whole lines from a line scanner, which
+  reads with fread, from an io_uring reader or from a decompressor.
+  Parser threads turn the blocks into rows of doubles and the calling thread hands them on in input order,
+  together with the messages about ignored lines. The stages pass blocks
+  through bounded single producer/single consumer queues; block i goes
+  to parser i%np and a fixed pool of blocks bounds the memory. Streams
+  have to be copied into the blocks, so they get smaller blocks and at
+  most MAX_STREAM_THREADS parsers: a pipe seldom delivers faster than a
+  few of them parse. A stage that finds its queue empty or full spins
+  briefly and then sleeps until the other side moves, so a slow pipe
+  doesn't keep idle threads polling.
+  The number of parsers follows thread_budget, so the files of a batch
+  share the processors. Small mapped files, a budget of one processor,
+  and systems where no threads can be started, are read the same way by
+  the calling thread alone. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#define SIZE_STEP 1000
+/* size of the blocks, and the maximal number of parser threads */
+#define CHUNK_SIZE (1UL<<22)
+#define MAX_THREADS 64
+/* the same for streams */
+#define STREAM_CHUNK_SIZE (1UL<<20)
+#define MAX_STREAM_THREADS 4
+#define PAGE_STEP 4096
+/* times a stage looks at its queue before it goes to sleep */
+#define SPINS 64
+
+struct ignored_line {
+  unsigned long line;   /* line number inside the chunk */
+  unsigned long rows;   /* rows accepted in the chunk before this line */
+  char *start,*end;
+};
+
+struct chunk {
+  char *start,*end;
+  char *buf;            /* the block of a stream */
+  unsigned long cap;
+  struct column_plan *plan;
+  unsigned int verbosity;
+  double *val;          /* accepted rows, one after the other */
+  unsigned long rows,max_rows,lines;
+  unsigned long first,stride;   /* number of the first line, see fill_chunk */
+  struct ignored_line *ign;
+  unsigned long nign,max_ign;
+  struct text_index *index;
+};
+
+struct source {
+  char *p,*end;         /* the rest of a mapped file */
+  struct line_scanner *scan;
+  unsigned long skip;
+  unsigned long stride,lines;
+  char first;
+};
+
+struct ring {
+  void **slot;
+  unsigned long mask;
+  atomic_ulong head,tail;
+  atomic_int sleepers;
+  pthread_mutex_t lock;
+  pthread_cond_t moved;     /* head or tail moved */
+};
+
+struct pipeline {
+  struct source *src;
+  unsigned int np;
+  struct ring free,*todo,*done;
+  atomic_int stop;
+};
+
+struct parser {
+  struct ring *todo,*done;
+};
+
+static void make_ring(struct ring *r,unsigned long n)
+{
+  unsigned long size=1;
+
+  while (size < n)
+    size *= 2;
+  check_alloc(r->slot=(void**)malloc(sizeof(void*)*size));
+  r->mask=size-1;
+  atomic_init(&r->head,0);
+  atomic_init(&r->tail,0);
+  atomic_init(&r->sleepers,0);
+  pthread_mutex_init(&r->lock,NULL);
+  pthread_cond_init(&r->moved,NULL);
+}
+
+static void free_ring(struct ring *r)
+{
+  pthread_mutex_destroy(&r->lock);
+  pthread_cond_destroy(&r->moved);
+  free(r->slot);
+}
+
+/* whether there is room in the ring to push, or an entry to pop */
+static int ring_ready(struct ring *r,int push)
+{
+  unsigned long h=atomic_load(&r->head),t=atomic_load(&r->tail);
+
+  return push ? (t-h <= r->mask) : (t != h);
+}
+
+/* waits until ring_ready, spinning a little and then sleeping. A sleeper
+   counts itself before it looks again, and the other side looks for
+   sleepers after it moved, so one of them always sees the other */
+static void ring_wait(struct ring *r,int push)
+{
+  unsigned int tries;
+
+  for (tries=0;tries < SPINS;tries++) {
+    if (ring_ready(r,push))
+      return;
+    sched_yield();
+  }
+  pthread_mutex_lock(&r->lock);
+  atomic_fetch_add(&r->sleepers,1);
+  while (!ring_ready(r,push))
+    pthread_cond_wait(&r->moved,&r->lock);
+  atomic_fetch_sub(&r->sleepers,1);
+  pthread_mutex_unlock(&r->lock);
+}
+
+static void ring_wake(struct ring *r)
+{
+  if (atomic_load(&r->sleepers) > 0) {
+    pthread_mutex_lock(&r->lock);
+    pthread_cond_broadcast(&r->moved);
+    pthread_mutex_unlock(&r->lock);
+  }
+}
+
+static void ring_push(struct ring *r,void *x)
+{
+  unsigned long t;
+
+  t=atomic_load_explicit(&r->tail,memory_order_relaxed);
+  ring_wait(r,1);
+  r->slot[t&r->mask]=x;
+  atomic_store(&r->tail,t+1);
+  ring_wake(r);
+}
+
+static void *ring_pop(struct ring *r)
+{
+  unsigned long h;
+  void *x;
+
+  h=atomic_load_explicit(&r->head,memory_order_relaxed);
+  ring_wait(r,0);
+  x=r->slot[h&r->mask];
+  atomic_store(&r->head,h+1);
+  ring_wake(r);
+  return x;
+}
+
+void print_first_line(char *who,double *val,unsigned int n)
+{
+  unsigned int i;
+
+  fprintf(stderr,"%s: first data item(s) used:\n",who);
+  for (i=0;i<n;i++)
+    fprintf(stderr,"%lf ",val[i]);
+  fprintf(stderr,"\n");
+}
+
+/* reports a line that is not used, naming its file if several are read */
+void print_ignored(unsigned long line,char *text,unsigned long len)
+{
+  char *file=current_input_file();
+
+  if (file != NULL)
+    fprintf(stderr,"Line %lu of %s ignored: %.*s\n",line,file,(int)len,text);
+  else
+    fprintf(stderr,"Line %lu ignored: %.*s\n",line,(int)len,text);
+}
+
+static void parse_chunk(struct chunk *c)
+{
+  struct text_index *ix=c->index;
+  unsigned long i,nl,len=(unsigned long)(c->end-c->start);
+  unsigned int n=c->plan->n;
+  int ok;
+
+  index_text(c->start,len,ix);
+  c->rows=c->lines=c->nign=0;
+  for (i=0;i < len;i=nl+1) {
+    nl=next_newline(ix,i);
+    /* lines between the sampled ones aren't looked at */
+    if ((c->stride > 1) && ((c->first+c->lines)%c->stride)) {
+      c->lines++;
+      continue;
+    }
+    if (c->rows == c->max_rows) {
+      c->max_rows *= 2;
+      check_alloc(c->val=(double*)realloc(c->val,
+					  sizeof(double)*c->max_rows*n));
+    }
+    /* a '\0' ends a line early, the plain scanner knows about that */
+    if (ix->zero)
+      ok=scan_columns(c->start+i,c->start+nl,c->plan,c->val+c->rows*n);
+    else
+      ok=scan_indexed_columns(ix,i,nl,c->plan,c->val+c->rows*n);
+    if (ok)
+      c->rows++;
+    else if (c->verbosity&VER_INPUT) {
+      if (c->nign == c->max_ign) {
+	c->max_ign=(c->max_ign == 0) ? 64 : 2*c->max_ign;
+	check_alloc(c->ign=(struct ignored_line*)
+		    realloc(c->ign,sizeof(struct ignored_line)*c->max_ign));
+      }
+      c->ign[c->nign].line=c->lines;
+      c->ign[c->nign].rows=c->rows;
+      c->ign[c->nign].start=c->start+i;
+      c->ign[c->nign].end=c->start+nl;
+      c->nign++;
+    }
+    c->lines++;
+  }
+}
+
+/* passes at most hl-count rows of the chunk on and reports the lines
+   the serial reader would have reported up to that point */
+static unsigned long commit_chunk(struct chunk *c,unsigned long count,
+				  unsigned long hl,unsigned long allcount,
+				  row_function put,void *data,char *who,
+				  unsigned int verbosity)
+{
+  unsigned int n=c->plan->n;
+  unsigned long j,k=0,rows;
+
+  rows=(c->rows < hl-count) ? c->rows : hl-count;
+  for (j=0;j<rows;j++) {
+    for (;(k < c->nign) && (c->ign[k].rows == j);k++)
+      print_ignored(allcount+c->ign[k].line+1,c->ign[k].start,
+		    (unsigned long)(c->ign[k].end-c->ign[k].start));
+    if ((count+j == 0) && (who != NULL) && (verbosity&VER_FIRST_LINE))
+      print_first_line(who,c->val,n);
+    put(c->val+j*n,n,data);
+  }
+  if (rows == c->rows)
+    for (;k < c->nign;k++)
+      print_ignored(allcount+c->ign[k].line+1,c->ign[k].start,
+		    (unsigned long)(c->ign[k].end-c->ign[k].start));
+
+  return count+rows;
+}
+
+static unsigned int parser_threads(void)
+{
+  long n=thread_budget();
+
+  if (n < 1)
+    n=1;
+  if (n > MAX_THREADS)
+    n=MAX_THREADS;
+  return (unsigned int)n;
+}
+
+static int fill_mapped(struct source *s,struct chunk *c)
+{
+  char *q;
+  volatile char touch;
+
+  if (s->p >= s->end)
+    return 0;
+  c->start=s->p;
+  if ((unsigned long)(s->end-s->p) <= CHUNK_SIZE)
+    s->p=s->end;
+  else if ((q=(char*)memchr(s->p+CHUNK_SIZE,'\n',
+			    (size_t)(s->end-s->p-CHUNK_SIZE))) == NULL)
+    s->p=s->end;
+  else
+    s->p=q+1;
+  c->end=s->p;
+  for (q=c->start;q < c->end;q += PAGE_STEP)
+    touch= *q;
+  (void)touch;
+
+  return 1;
+}
+
+static int fill_stream(struct source *s,struct chunk *c)
+{
+  unsigned long len;
+  char *nl;
+
+  for (;;) {
+    if ((c->start=scan_block(s->scan,&c->buf,&c->cap,&len)) == NULL)
+      return 0;
+    c->end=c->start+len;
+
+    if (s->first) {
+      s->first=0;
+      if ((len >= 8) && !memcmp(c->start,BINARY_MAGIC,(size_t)8)) {
+	fprintf(stderr,"Binary column files can't be read from stdin."
+		" Give the file name instead. Exiting!\n");
+	exit(BINARY_COLUMNS_WRONG_FORMAT);
+      }
+    }
+
+    for (;(s->skip > 0) && (c->start < c->end);s->skip--) {
+      if ((nl=(char*)memchr(c->start,'\n',(size_t)(c->end-c->start))) == NULL)
+	c->start=c->end;
+      else
+	c->start=nl+1;
+    }
+    if (c->start < c->end)
+      return 1;
+  }
+}
+
+/* the next block, numbered by its first line if only every stride-th
+   line is read */
+static int fill_chunk(struct source *s,struct chunk *c)
+{
+  if (!((s->scan != NULL) ? fill_stream(s,c) : fill_mapped(s,c)))
+    return 0;
+  c->stride=s->stride;
+  if (s->stride > 1) {
+    c->first=s->lines;
+    s->lines += count_newlines(c->start,(unsigned long)(c->end-c->start));
+  }
+  return 1;
+}
+
+static void *reader_thread(void *arg)
+{
+  struct pipeline *pl=(struct pipeline*)arg;
+  struct chunk *c;
+  unsigned long seq=0;
+  unsigned int t;
+
+  while (!atomic_load(&pl->stop)) {
+    c=(struct chunk*)ring_pop(&pl->free);
+    if (atomic_load(&pl->stop) || !fill_chunk(pl->src,c))
+      break;
+    ring_push(&pl->todo[seq%pl->np],c);
+    seq++;
+  }
+  for (t=0;t<pl->np;t++)
+    ring_push(&pl->todo[(seq+t)%pl->np],NULL);
+
+  return NULL;
+}
+
+static void *parser_thread(void *arg)
+{
+  struct parser *p=(struct parser*)arg;
+  struct chunk *c;
+
+  while ((c=(struct chunk*)ring_pop(p->todo)) != NULL) {
+    parse_chunk(c);
+    ring_push(p->done,c);
+  }
+  ring_push(p->done,NULL);
+
+  return NULL;
+}
+
+/* all stages one after the other on the calling thread */
+static unsigned long read_serial(struct source *s,struct chunk *c,
+				 unsigned long hl,row_function put,void *data,
+				 char *who,unsigned int verbosity)
+{
+  unsigned long count=0,allcount=0;
+
+  while ((count < hl) && fill_chunk(s,c)) {
+    parse_chunk(c);
+    count=commit_chunk(c,count,hl,allcount,put,data,who,verbosity);
+    allcount += c->lines;
+  }
+  return count;
+}
+
+static unsigned long read_staged(struct source *s,struct chunk *pool,
+				 unsigned int npool,unsigned int np,
+				 unsigned long hl,row_function put,void *data,
+				 char *who,unsigned int verbosity)
+{
+  struct pipeline pl;
+  struct parser *parser;
+  struct chunk *c;
+  pthread_t reader,*thread;
+  unsigned int t,started;
+  unsigned long seq,count=0,allcount=0;
+
+  pl.src=s;
+  pl.np=np;
+  atomic_init(&pl.stop,0);
+  make_ring(&pl.free,(unsigned long)npool);
+  check_alloc(pl.todo=(struct ring*)malloc(sizeof(struct ring)*np));
+  check_alloc(pl.done=(struct ring*)malloc(sizeof(struct ring)*np));
+  check_alloc(parser=(struct parser*)malloc(sizeof(struct parser)*np));
+  check_alloc(thread=(pthread_t*)malloc(sizeof(pthread_t)*np));
+  for (t=0;t<npool;t++)
+    ring_push(&pl.free,&pool[t]);
+  for (t=0;t<np;t++) {
+    make_ring(&pl.todo[t],(unsigned long)npool+1);
+    make_ring(&pl.done[t],(unsigned long)npool+1);
+    parser[t].todo= &pl.todo[t];
+    parser[t].done= &pl.done[t];
+  }
+
+  for (started=0;started<np;started++)
+    if (pthread_create(&thread[started],NULL,parser_thread,
+		       &parser[started]) != 0)
+      break;
+  if (started > 0) {
+    pl.np=started;
+    if (pthread_create(&reader,NULL,reader_thread,&pl) != 0) {
+      for (t=0;t<started;t++)
+	ring_push(&pl.todo[t],NULL);
+      for (t=0;t<started;t++)
+	pthread_join(thread[t],NULL);
+      started=0;
+    }
+  }
+
+  if (started == 0)
+    count=read_serial(s,&pool[0],hl,put,data,who,verbosity);
+  else {
+    /* blocks come back in input order, after hl rows they are only
+       recycled until the reader has noticed the stop */
+    for (seq=0;;seq++) {
+      if ((c=(struct chunk*)ring_pop(&pl.done[seq%pl.np])) == NULL)
+	break;
+      if (count < hl) {
+	count=commit_chunk(c,count,hl,allcount,put,data,who,verbosity);
+	allcount += c->lines;
+	if (count >= hl)
+	  atomic_store(&pl.stop,1);
+      }
+      ring_push(&pl.free,c);
+    }
+    pthread_join(reader,NULL);
+    for (t=0;t<started;t++)
+      pthread_join(thread[t],NULL);
+  }
+
+  for (t=0;t<np;t++) {
+    free_ring(&pl.todo[t]);
+    free_ring(&pl.done[t]);
+  }
+  free_ring(&pl.free);
+  free(pl.todo);
+  free(pl.done);
+  free(parser);
+  free(thread);
+
+  return count;
+}
+
+/* reads the mapped file map of size bytes, or fin, u or z if map is NULL,
+   skips ex lines, reads every stride-th line of the rest and hands at
+   most hl accepted rows to put */
+unsigned long read_pipeline(char *map,unsigned long size,FILE *fin,
+			    struct uring_reader *u,struct decompressor *z,
+			    unsigned long hl,unsigned long ex,
+			    unsigned long stride,
+			    struct column_plan *plan,row_function put,
+			    void *data,char *who,unsigned int verbosity)
+{
+  struct source s;
+  struct chunk *pool;
+  unsigned int t,np,npool;
+  unsigned long i,count;
+  char *q;
+
+  s.scan=NULL;
+  if (map == NULL)
+    s.scan=make_line_scanner(fin,u,z,STREAM_CHUNK_SIZE+1);
+  s.skip=ex;
+  s.stride=stride;
+  s.lines=0;
+  s.first=1;
+  if (map != NULL) {
+    s.p=map;
+    s.end=map+size;
+    for (i=0;(i<ex) && (s.p < s.end);i++) {
+      if ((q=(char*)memchr(s.p,'\n',(size_t)(s.end-s.p))) == NULL)
+	s.p=s.end;
+      else
+	s.p=q+1;
+    }
+  }
+
+  np=parser_threads();
+  if ((map == NULL) && (np > MAX_STREAM_THREADS))
+    np=MAX_STREAM_THREADS;
+  npool=2*np+2;
+  check_alloc(pool=(struct chunk*)calloc((size_t)npool,sizeof(struct chunk)));
+  for (t=0;t<npool;t++) {
+    pool[t].plan=plan;
+    pool[t].verbosity=verbosity;
+    pool[t].max_rows=SIZE_STEP;
+    check_alloc(pool[t].val=(double*)malloc(sizeof(double)*
+					    pool[t].max_rows*plan->n));
+    pool[t].index=make_text_index();
+  }
+
+  if ((np == 1) ||
+      ((map != NULL) && ((unsigned long)(s.end-s.p) <= CHUNK_SIZE)))
+    count=read_serial(&s,&pool[0],hl,put,data,who,verbosity);
+  else
+    count=read_staged(&s,pool,npool,np,hl,put,data,who,verbosity);
+
+  for (t=0;t<npool;t++) {
+    free(pool[t].val);
+    if (pool[t].ign != NULL)
+      free(pool[t].ign);
+    if (pool[t].buf != NULL)
+      free(pool[t].buf);
+    free_text_index(pool[t].index);
+  }
+  free(pool);
+  if (s.scan != NULL)
+    free_line_scanner(s.scan);
+
+  return count;
+}
+#undef SIZE_STEP
+#undef CHUNK_SIZE
+#undef MAX_THREADS
+#undef STREAM_CHUNK_SIZE
+#undef MAX_STREAM_THREADS
+#undef PAGE_STEP
+#undef SPINS
@@ -0,0 +1,278 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Common input engine of get_series, get_multi_series and the
+  streaming readers. stream_columns hands every accepted row to a
+  row_function, read_columns collects the rows into one array per column.
+  The first index of the returned array runs the requested columns,
+  the second the time series index.
+  Binary column files, .npy and raw files are read in place from the
+  mapped file, see array_files.c. Regular text files are parsed
+  straight out of the mapped pages, stdin and
+  everything else is read in blocks. Both go through the staged reader
+  of pipeline.c, which hands the rows on in input order, so the result
+  is the same as reading the input line by line. Setting TISEAN_READER
+  to stdio or uring reads regular text files in blocks with fread or
+  io_uring instead of mapping them. TISEAN_CACHE=on keeps the parsed
+  columns of text files in a cache next to them, see column_cache.c,
+  and TISEAN_INDEX=on an index of their lines for -x, see line_index.c.
+  gzip, xz and zstd compressed files are decompressed by a background
+  thread and read as a stream, see decompress.c. Several data files are
+  read as one, see input_files.c.
+  All of them read only the lines selected with sample_lines,
+  see sampling.c. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#define SIZE_STEP 1000
+#define READER_MMAP 0
+#define READER_STDIO 1
+#define READER_URING 2
+
+struct collector {
+  double **x;
+  unsigned long count,max_size;
+};
+
+static void store_row(double *val,unsigned int n,void *data)
+{
+  struct collector *c=(struct collector*)data;
+  unsigned int i;
+
+  if (c->count == c->max_size) {
+    c->max_size *= 2;
+    for (i=0;i<n;i++)
+      check_alloc(c->x[i]=(double*)realloc(c->x[i],
+					   sizeof(double)*c->max_size));
+  }
+  for (i=0;i<n;i++)
+    c->x[i][c->count]=val[i];
+  c->count++;
+}
+
+/* the rows of a mapped array file, one after the other, or the ones
+   sample_lines asks for */
+static unsigned long read_array_rows(char *name,struct array_layout *a,
+				     unsigned long hl,unsigned long ex,
+				     struct column_plan *plan,
+				     row_function put,void *data)
+{
+  unsigned int i;
+  unsigned long j,c,rows,stride=sample_stride(),*index=NULL;
+  double *val;
+
+  check_array_columns(name,a,plan);
+  rows=(ex < a->rows) ? (a->rows-ex+stride-1)/stride : 0;
+  if (sample_size() > 0)
+    index=sample_indices(rows,sample_size(),&rows);
+  if (rows > hl)
+    rows=hl;
+
+  check_alloc(val=(double*)malloc(sizeof(double)*plan->n));
+  for (c=0;c<rows;c++) {
+    j=ex+((index != NULL) ? index[c] : c)*stride;
+    for (i=0;i<plan->n;i++)
+      val[plan->slot[i]]=array_element(a,j,plan->col[i]-1);
+    put(val,plan->n,data);
+  }
+  free(val);
+  if (index != NULL)
+    free(index);
+
+  return rows;
+}
+
+/* the reader for text files chosen with the environment variable
+   TISEAN_READER: mmap (default), stdio or uring */
+static int text_reader(void)
+{
+  char *r;
+
+  if (((r=getenv("TISEAN_READER")) == NULL) || !strcmp(r,"mmap"))
+    return READER_MMAP;
+  if (!strcmp(r,"stdio"))
+    return READER_STDIO;
+  if (!strcmp(r,"uring"))
+    return READER_URING;
+  fprintf(stderr,"Unknown TISEAN_READER %s. Using mmap\n",r);
+  return READER_MMAP;
+}
+
+/* reads from the mapping if there is one, from name or stdin otherwise */
+static unsigned long read_any(char *name,char *map,unsigned long size,
+			      unsigned long hl,unsigned long ex,
+			      struct column_plan *plan,row_function put,
+			      void *data,char *who,unsigned int verbosity)
+{
+  int reader=READER_MMAP;
+  unsigned long count,start=0;
+  struct uring_reader *u=NULL;
+  struct decompressor *z=NULL;
+  struct line_scanner *scan;
+  struct array_layout a;
+  FILE *fin;
+
+  /* compressed files are read as a stream, the decompressor owns map */
+  if ((map != NULL) && ((z=open_decompressor(name,map,size)) != NULL))
+    map=NULL;
+  if (map != NULL) {
+    if (array_layout(name,map,size,&a)) {
+      count=read_array_rows(name,&a,hl,ex,plan,put,data);
+      unmap_file(map,size);
+      return count;
+    }
+    if (read_cached(name,map,size,hl,ex,plan,put,data,who,verbosity,
+		    &count)) {
+      unmap_file(map,size);
+      return count;
+    }
+    /* the excluded lines are skipped here, all readers start behind them */
+    start=line_offset(name,map,size,ex,verbosity);
+    ex=0;
+    if (sample_size() > 0) {
+      count=read_sample(map+start,size-start,NULL,hl,ex,plan,put,data,who,
+			verbosity);
+      unmap_file(map,size);
+      return count;
+    }
+    if ((reader=text_reader()) == READER_MMAP) {
+      count=read_pipeline(map+start,size-start,NULL,NULL,NULL,hl,ex,
+			  sample_stride(),plan,put,data,who,verbosity);
+      unmap_file(map,size);
+      return count;
+    }
+    unmap_file(map,size);
+  }
+
+  if ((z != NULL) || ((reader == READER_URING) &&
+		     ((u=open_uring_reader(name,start)) != NULL)))
+    fin=NULL;
+  else if (name == NULL)
+    fin=stdin;
+  else {
+    fin=fopen(name,"r");
+    if (start > 0)
+      fseek(fin,(long)start,SEEK_SET);
+  }
+  if (sample_size() > 0) {
+    scan=make_line_scanner(fin,u,z,INPUT_SIZE);
+    count=read_sample(NULL,0,scan,hl,ex,plan,put,data,who,verbosity);
+    free_line_scanner(scan);
+  }
+  else
+    count=read_pipeline(NULL,0,fin,u,z,hl,ex,sample_stride(),plan,put,
+			data,who,verbosity);
+  if (u != NULL)
+    close_uring_reader(u);
+  if (z != NULL)
+    close_decompressor(z);
+  if ((fin != NULL) && (fin != stdin))
+    fclose(fin);
+
+  return count;
+}
+
+/* the number of lines of the file name, the rows of an array file */
+unsigned long count_lines(char *name)
+{
+  char *map;
+  unsigned long size,count,len;
+  struct decompressor *z=NULL;
+  struct line_scanner *scan;
+  struct array_layout a;
+  FILE *fin=NULL;
+
+  map=map_file(name,&size);
+  if ((map != NULL) && ((z=open_decompressor(name,map,size)) != NULL))
+    map=NULL;
+  if (map != NULL) {
+    if (array_layout(name,map,size,&a))
+      count=a.rows;
+    else
+      count=count_newlines(map,size)+((size > 0) && (map[size-1] != '\n'));
+    unmap_file(map,size);
+    return count;
+  }
+  if ((z == NULL) && ((fin=fopen(name,"r")) == NULL))
+    return 0;
+  scan=make_line_scanner(fin,NULL,z,INPUT_SIZE);
+  for (count=0;scan_line(scan,&len) != NULL;count++);
+  free_line_scanner(scan);
+  if (z != NULL)
+    close_decompressor(z);
+  if (fin != NULL)
+    fclose(fin);
+
+  return count;
+}
+
+unsigned long stream_columns(char *name,unsigned long hl,unsigned long ex,
+			     struct column_plan *plan,row_function put,
+			     void *data,char *who,unsigned int verbosity)
+{
+  char *map;
+  unsigned long size;
+  unsigned int n;
+
+  if (input_files(name,&n) != NULL)
+    return stream_input_files(hl,ex,plan,put,data,who,verbosity);
+  map=map_file(name,&size);
+  return read_any(name,map,size,hl,ex,plan,put,data,who,verbosity);
+}
+
+double **read_columns(char *name,unsigned long *l,unsigned long ex,
+		      struct column_plan *plan,char *who,
+		      unsigned int verbosity)
+{
+  char *map;
+  unsigned int i;
+  unsigned long size;
+  struct collector c;
+  struct array_layout a;
+
+  if (input_files(name,&i) != NULL)
+    return read_input_files(l,ex,plan,who,verbosity);
+  map=map_file(name,&size);
+  /* a sample can't be handed out as the mapped columns */
+  if ((map != NULL) && (sample_stride() == 1) && (sample_size() == 0) &&
+      array_layout(name,map,size,&a))
+    return map_array_columns(name,map,size,&a,l,ex,plan,verbosity);
+
+  c.count=0;
+  c.max_size=SIZE_STEP;
+  check_alloc(c.x=(double**)malloc(sizeof(double*)*plan->n));
+  for (i=0;i<plan->n;i++)
+    check_alloc(c.x[i]=(double*)malloc(sizeof(double)*c.max_size));
+
+  read_any(name,map,size,*l,ex,plan,store_row,&c,who,verbosity);
+
+  if ((c.count > 0) && (c.max_size > c.count))
+    for (i=0;i<plan->n;i++)
+      check_alloc(c.x[i]=(double*)realloc(c.x[i],sizeof(double)*c.count));
+
+  *l=c.count;
+  return c.x;
+}
+#undef SIZE_STEP
+#undef READER_MMAP
+#undef READER_STDIO
+#undef READER_URING
@@ -0,0 +1,272 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Subsampling of the input. sample_lines makes the readers take
+  only every stride-th line after the excluded ones, and of those, if n
+  is not 0, a random sample of n lines. The sample is drawn by
+  reservoir sampling (Li's algorithm L), which decides how many lines
+  to pass over before the next one is kept, so lines that are not kept
+  are only looked at for their newline. The kept lines are handed on
+  in input order. The random numbers start from a fixed seed, so
+  reading a file twice gives the same sample. A sample of several files
+  is drawn from their lines together, the readers then take the lines
+  of each file given with sample_given, see input_files.c. Lines of the
+  sample that are not numbers are dropped, as in a single file. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#define SEED 0x5DEECE66DULL
+
+static unsigned long stride=1,size=0;
+static unsigned long *given=NULL,ngiven=0;
+
+struct kept_line {
+  unsigned long line;
+  char *text;
+  unsigned long len,cap;        /* cap is 0 for lines not copied */
+};
+
+struct reservoir {
+  unsigned long n,next;         /* size, next candidate to keep */
+  double w;
+  unsigned long long state;
+  struct kept_line *kept;
+};
+
+void sample_lines(unsigned long k,unsigned long n)
+{
+  stride=(k == 0) ? 1 : k;
+  size=n;
+}
+
+unsigned long sample_stride(void)
+{
+  return stride;
+}
+
+unsigned long sample_size(void)
+{
+  return size;
+}
+
+/* makes the readers take the candidates index[0..n-1], which are sorted,
+   instead of drawing a sample, until it is called with NULL */
+void sample_given(unsigned long *index,unsigned long n)
+{
+  given=index;
+  ngiven=(index != NULL) ? n : 0;
+}
+
+/* xorshift64*, uniform in (0,1) */
+static double uniform(struct reservoir *r)
+{
+  r->state ^= r->state >> 12;
+  r->state ^= r->state << 25;
+  r->state ^= r->state >> 27;
+  return ((double)((r->state*0x2545F4914F6CDD1DULL) >> 11)+0.5)/
+    9007199254740992.0;
+}
+
+/* the candidate after c that is kept next */
+static void skip_ahead(struct reservoir *r,unsigned long c)
+{
+  double s=floor(log(uniform(r))/log(1.0-r->w));
+
+  r->next=(s < (double)(ULONG_MAX-c-1)) ? c+(unsigned long)s+1 : ULONG_MAX;
+}
+
+static struct reservoir *make_reservoir(unsigned long n)
+{
+  struct reservoir *r;
+
+  check_alloc(r=(struct reservoir*)malloc(sizeof(struct reservoir)));
+  check_alloc(r->kept=(struct kept_line*)calloc((size_t)n,
+						sizeof(struct kept_line)));
+  r->n=n;
+  r->next=0;
+  r->w=1.0;
+  r->state=SEED;
+  return r;
+}
+
+static void free_reservoir(struct reservoir *r)
+{
+  unsigned long i;
+
+  for (i=0;i<r->n;i++)
+    if (r->kept[i].cap > 0)
+      free(r->kept[i].text);
+  free(r->kept);
+  free(r);
+}
+
+/* the slot to keep candidate c in, candidates come in increasing order.
+   Returns -1 if c is not kept. With given candidates, r->next counts the
+   ones already kept */
+static long keep_slot(struct reservoir *r,unsigned long c)
+{
+  long slot;
+
+  if (given != NULL) {
+    if ((r->next < ngiven) && (given[r->next] == c))
+      return (long)r->next++;
+    return -1;
+  }
+  if (c < r->n) {
+    if (c == r->n-1) {
+      r->w=exp(log(uniform(r))/(double)r->n);
+      skip_ahead(r,c);
+    }
+    return (long)c;
+  }
+  if (c != r->next)
+    return -1;
+  slot=(long)(uniform(r)*(double)r->n);
+  if (slot >= (long)r->n)
+    slot=(long)r->n-1;
+  r->w *= exp(log(uniform(r))/(double)r->n);
+  skip_ahead(r,c);
+  return slot;
+}
+
+static int by_line(const void *a,const void *b)
+{
+  unsigned long la=((struct kept_line*)a)->line,lb=((struct kept_line*)b)->line;
+
+  return (la > lb)-(la < lb);
+}
+
+static int by_index(const void *a,const void *b)
+{
+  unsigned long la= *(unsigned long*)a,lb= *(unsigned long*)b;
+
+  return (la > lb)-(la < lb);
+}
+
+/* a random sample of n of the candidates 0..total-1, sorted. *kept is
+   set to its size */
+unsigned long *sample_indices(unsigned long total,unsigned long n,
+			      unsigned long *kept)
+{
+  struct reservoir *r;
+  unsigned long c,*index;
+  long slot;
+
+  if (given != NULL) {
+    for (*kept=0;(*kept < ngiven) && (given[*kept] < total);(*kept)++);
+    check_alloc(index=(unsigned long*)malloc(sizeof(unsigned long)*
+					     (*kept+1)));
+    memcpy(index,given,sizeof(unsigned long)*(*kept));
+    return index;
+  }
+  *kept=(total < n) ? total : n;
+  check_alloc(index=(unsigned long*)malloc(sizeof(unsigned long)*(*kept+1)));
+  if (*kept == 0)
+    return index;
+  r=make_reservoir(*kept);
+  for (c=0;c < total;c=(c < r->n-1) ? c+1 : r->next) {
+    if ((slot=keep_slot(r,c)) >= 0)
+      index[slot]=c;
+  }
+  free_reservoir(r);
+  qsort(index,(size_t)*kept,sizeof(unsigned long),by_index);
+
+  return index;
+}
+
+/* reads the lines of the mapped text, or from scan if map is NULL,
+   keeps a sample of them as set by sample_lines and hands at most hl
+   accepted rows among them to put. The first ex lines are skipped */
+unsigned long read_sample(char *map,unsigned long len,
+			  struct line_scanner *scan,unsigned long hl,
+			  unsigned long ex,struct column_plan *plan,
+			  row_function put,void *data,char *who,
+			  unsigned int verbosity)
+{
+  struct reservoir *r;
+  struct kept_line *k;
+  char *p=map,*end=map+len,*line,*nl;
+  unsigned long i,j,n,nc=0,count=0,ll;
+  long slot;
+  double *val;
+
+  r=make_reservoir((given != NULL) ? ngiven : size);
+  for (i=0;;i++) {
+    if (map != NULL) {
+      if (p >= end)
+	break;
+      line=p;
+      if ((nl=(char*)memchr(p,'\n',(size_t)(end-p))) == NULL)
+	nl=end;
+      ll=(unsigned long)(nl-line);
+      p=nl+1;
+    }
+    else {
+      if ((line=scan_line(scan,&ll)) == NULL)
+	break;
+      if ((i == 0) && (ll >= 8) && !memcmp(line,BINARY_MAGIC,(size_t)8)) {
+	fprintf(stderr,"Binary column files can't be read from stdin."
+		" Give the file name instead. Exiting!\n");
+	exit(BINARY_COLUMNS_WRONG_FORMAT);
+      }
+    }
+    if ((i < ex) || ((i-ex)%stride))
+      continue;
+    if ((slot=keep_slot(r,nc++)) < 0)
+      continue;
+    k=r->kept+slot;
+    k->line=i-ex;
+    if (map != NULL)
+      k->text=line;
+    else {
+      /* lines of a stream have to be copied */
+      if (k->cap < ll+1) {
+	k->cap=ll+1;
+	check_alloc(k->text=(char*)realloc(k->text,(size_t)k->cap));
+      }
+      memcpy(k->text,line,(size_t)ll);
+    }
+    k->len=ll;
+  }
+
+  n=(nc < r->n) ? nc : r->n;
+  qsort(r->kept,(size_t)n,sizeof(struct kept_line),by_line);
+  check_alloc(val=(double*)malloc(sizeof(double)*plan->n));
+  for (j=0;(j < n) && (count < hl);j++) {
+    k=r->kept+j;
+    if (scan_columns(k->text,k->text+k->len,plan,val)) {
+      if ((count == 0) && (who != NULL) && (verbosity&VER_FIRST_LINE))
+	print_first_line(who,val,plan->n);
+      put(val,plan->n,data);
+      count++;
+    }
+    else if (verbosity&VER_INPUT)
+      print_ignored(k->line+1,k->text,k->len);
+  }
+  free(val);
+  free_reservoir(r);
+
+  return count;
+}
+#undef SEED
@@ -0,0 +1,130 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: A line is split into whitespace separated fields in one pass.
+  Every field up to the last one asked for has to be a number, as it
+  had to be for the "%*lf%lf" formats this replaces, but only the
+  fields that were asked for are converted, the others are just checked
+  with is_number. Each field is stored once, even if it is requested
+  several times. With a text index the fields are found from
+  its whitespace mask. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "tsa.h"
+
+struct column_plan *make_column_plan(unsigned int *hcol,unsigned int n)
+{
+  unsigned int i,j,hc,hs;
+  struct column_plan *plan;
+
+  check_alloc(plan=(struct column_plan*)malloc(sizeof(struct column_plan)));
+  check_alloc(plan->col=(unsigned int*)malloc(sizeof(unsigned int)*n));
+  check_alloc(plan->slot=(unsigned int*)malloc(sizeof(unsigned int)*n));
+  plan->n=n;
+
+  /* column 0 has always been read as column 1 */
+  for (i=0;i<n;i++) {
+    plan->col[i]=(hcol[i] == 0) ? 1 : hcol[i];
+    plan->slot[i]=i;
+  }
+  /* n is small, a straight insertion sort is fine */
+  for (i=1;i<n;i++) {
+    hc=plan->col[i];
+    hs=plan->slot[i];
+    for (j=i;(j > 0) && (plan->col[j-1] > hc);j--) {
+      plan->col[j]=plan->col[j-1];
+      plan->slot[j]=plan->slot[j-1];
+    }
+    plan->col[j]=hc;
+    plan->slot[j]=hs;
+  }
+
+  return plan;
+}
+
+void free_column_plan(struct column_plan *plan)
+{
+  free(plan->col);
+  free(plan->slot);
+  free(plan);
+}
+
+/* scans the line [p,end) and stores the requested columns in
+   val[0..plan->n-1] in the order they were requested.
+   A '\0' also ends the line.
+   Returns 1 if all columns were found, 0 otherwise */
+int scan_columns(char *p,char *end,struct column_plan *plan,double *val)
+{
+  unsigned int i=0,field=0;
+  char *start;
+  double h;
+
+  while (i < plan->n) {
+    while ((p < end) && isspace((unsigned char)*p))
+      p++;
+    if ((p == end) || (*p == '\0'))
+      return 0;
+    start=p;
+    while ((p < end) && *p && !isspace((unsigned char)*p))
+      p++;
+    if (++field < plan->col[i]) {
+      if (!is_number(start,(unsigned long)(p-start)))
+	return 0;
+    }
+    else {
+      if (!parse_double(start,(unsigned long)(p-start),&h))
+	return 0;
+      do {
+	val[plan->slot[i++]]=h;
+      } while ((i < plan->n) && (plan->col[i] == field));
+    }
+  }
+
+  return 1;
+}
+
+/* the same for the line [i,end) of an indexed text without '\0' */
+int scan_indexed_columns(struct text_index *ix,unsigned long i,
+			 unsigned long end,struct column_plan *plan,
+			 double *val)
+{
+  unsigned int k=0,field=0;
+  unsigned long start;
+  double h;
+
+  while (k < plan->n) {
+    if ((start=next_field(ix,&i,end)) == end)
+      return 0;
+    if (++field < plan->col[k]) {
+      if (!is_number(ix->text+start,i-start))
+	return 0;
+    }
+    else {
+      if (!parse_double(ix->text+start,i-start,&h))
+	return 0;
+      do {
+	val[plan->slot[k++]]=h;
+      } while ((k < plan->n) && (plan->col[k] == field));
+    }
+  }
+
+  return 1;
+}
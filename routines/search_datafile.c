@@ -63,15 +63,17 @@ char look_for_column(char *name,unsigned int *col)
   return vcol;
 }
 
-char* search_datafile(int n,char **names,unsigned int *col,
-		      unsigned int verbosity)
+/* the data files on the command line in their order, NULL for stdin */
+char **search_datafiles(int n,char **names,unsigned int *col,
+			unsigned int verbosity,unsigned int *nfiles)
 {
-  char valid=0,validcol=0;
-  char *retname=NULL;
-  int i;
+  char valid=0,validcol=0,colset=0;
+  char **found,*swap;
+  int i,nfound=0;
   unsigned int hcol;
   FILE *test;
 
+  check_alloc(found=(char**)malloc(sizeof(char*)*n));
   for (i=n-1;i>0;i--) {
     if (names[i] != NULL) {
       valid=0;
@@ -84,30 +86,44 @@ char* search_datafile(int n,char **names,unsigned int *col,
 	}
 	else {
 	  fclose(test);
-	  if ((col != 0) && (validcol == 1))
+	  /* the column given with the last file counts */
+	  if ((col != 0) && (validcol == 1) && !colset) {
 	    *col=hcol;
-	  if (col != 0) {
-	    if (verbosity&VER_INPUT)
-	      fprintf(stderr,"Using %s as datafile, reading column %u\n",
-		      names[i],*col);
+	    colset=1;
 	  }
-	  else {
-	    if (verbosity&VER_INPUT)
-	      fprintf(stderr,"Using %s as datafile!\n",names[i]);
-	  }
-	  check_alloc(retname=(char*)calloc(strlen(names[i])+1,(size_t)1));
-	  strcpy(retname,names[i]);
+	  found[nfound++]=names[i];
 	  names[i]=NULL;
-	  return retname;
 	}
       }
       else {
-	valid=1;
+	valid=(nfound == 0);
 	break;
       }
     }
   }
 
+  *nfiles=(unsigned int)nfound;
+  if (nfound > 0) {
+    for (i=0;i<nfound/2;i++) {
+      swap=found[i];
+      found[i]=found[nfound-1-i];
+      found[nfound-1-i]=swap;
+    }
+    for (i=0;i<nfound;i++) {
+      if (col != 0) {
+	if (verbosity&VER_INPUT)
+	  fprintf(stderr,"Using %s as datafile, reading column %u\n",
+		  found[i],*col);
+      }
+      else {
+	if (verbosity&VER_INPUT)
+	  fprintf(stderr,"Using %s as datafile!\n",found[i]);
+      }
+    }
+    return found;
+  }
+  free(found);
+
   if (valid == 1) {
     if (verbosity&VER_INPUT)
       fprintf(stderr,"Reading input from stdin!\n");
@@ -123,3 +139,20 @@ char* search_datafile(int n,char **names,unsigned int *col,
 
   return NULL;
 }
+
+char* search_datafile(int n,char **names,unsigned int *col,
+		      unsigned int verbosity)
+{
+  char *retname,**found;
+  unsigned int nfound;
+
+  if ((found=search_datafiles(n,names,col,verbosity,&nfound)) == NULL)
+    return NULL;
+  check_alloc(retname=(char*)calloc(strlen(found[0])+1,(size_t)1));
+  strcpy(retname,found[0]);
+  /* several files are read one after the other, see input_files.c */
+  if (nfound > 1)
+    set_input_files(retname,found,nfound);
+  free(found);
+  return retname;
+}
@@ -0,0 +1,114 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Files kept next to an input file foo.dat, like the column cache
+  and the line index. They are named .foo.dat<ext>, are switched on by
+  an environment variable set to on, and are written to a temporary
+  file that is renamed when complete, so a reader never sees half of
+  one. Whether one still belongs to foo.dat is told by a sidecar_key
+  of its size and modification time. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "tsa.h"
+
+/* whether the environment variable var is on */
+int sidecar_wanted(char *var)
+{
+  char *c;
+
+  if (((c=getenv(var)) == NULL) || !strcmp(c,"off"))
+    return 0;
+  if (!strcmp(c,"on"))
+    return 1;
+  fprintf(stderr,"Unknown %s %s. Taking it as off\n",var,c);
+  return 0;
+}
+
+char *sidecar_name(char *name,char *ext)
+{
+  char *cname,*base;
+  size_t dir;
+
+  base=strrchr(name,'/');
+  base=(base == NULL) ? name : base+1;
+  dir=(size_t)(base-name);
+  check_alloc(cname=(char*)malloc(strlen(name)+strlen(ext)+2));
+  memcpy(cname,name,dir);
+  sprintf(cname+dir,".%s%s",base,ext);
+
+  return cname;
+}
+
+/* the key of the file name, 0 if it can't be had */
+int sidecar_key(char *name,struct sidecar_key *key)
+{
+  struct stat st;
+
+  if ((name == NULL) || (stat(name,&st) != 0))
+    return 0;
+  memset(key,0,sizeof(struct sidecar_key));
+  key->size=(unsigned long long)st.st_size;
+  key->mtime=(long long)st.st_mtim.tv_sec;
+  key->mtime_nsec=(long long)st.st_mtim.tv_nsec;
+  return 1;
+}
+
+/* opens a temporary file next to cname, NULL if that isn't possible */
+FILE *create_sidecar(char *cname,char **tmp)
+{
+  int fd;
+  mode_t mask;
+  FILE *fout;
+
+  check_alloc(*tmp=(char*)malloc(strlen(cname)+8));
+  sprintf(*tmp,"%sXXXXXX",cname);
+  if ((fd=mkstemp(*tmp)) < 0) {
+    free(*tmp);
+    return NULL;
+  }
+  /* mkstemp makes the file private, give it the usual permissions */
+  mask=umask(0);
+  umask(mask);
+  fchmod(fd,0666&~mask);
+  if ((fout=fdopen(fd,"wb")) == NULL) {
+    close(fd);
+    unlink(*tmp);
+    free(*tmp);
+    return NULL;
+  }
+  return fout;
+}
+
+/* closes the temporary file and puts it in place of cname if ok.
+   Returns 0 if the sidecar wasn't written */
+int finish_sidecar(FILE *fout,char *tmp,char *cname,int ok)
+{
+  ok=(fclose(fout) == 0) && ok;
+  if (ok)
+    ok=(rename(tmp,cname) == 0);
+  if (!ok)
+    unlink(tmp);
+  free(tmp);
+
+  return ok;
+}
@@ -0,0 +1,112 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Histogram with more bins than fit into memory, of which only
+  few are hit. The counts are kept in a hash table with open addressing,
+  keyed by the number of the bin; bins that were never hit cost nothing.
+  The table doubles once it is half full. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "tsa.h"
+
+#define EMPTY ULONG_MAX
+#define FIRST_BITS 10
+
+static unsigned long slot(struct sparse_bins *h,unsigned long key)
+{
+  unsigned long i;
+
+  /* Fibonacci hashing spreads runs of neighbouring bins */
+  i=(unsigned long)(((unsigned long long)key*0x9e3779b97f4a7c15ULL)>>
+		    (64-h->bits));
+  while ((h->key[i] != EMPTY) && (h->key[i] != key))
+    i=(i+1)&(h->size-1);
+  return i;
+}
+
+static void make_table(struct sparse_bins *h,unsigned int bits)
+{
+  unsigned long i;
+
+  h->bits=bits;
+  h->size=1UL<<bits;
+  check_alloc(h->key=(unsigned long*)malloc(sizeof(unsigned long)*h->size));
+  check_alloc(h->count=(unsigned long*)calloc((size_t)h->size,
+					      sizeof(unsigned long)));
+  for (i=0;i<h->size;i++)
+    h->key[i]=EMPTY;
+}
+
+struct sparse_bins *make_sparse_bins(void)
+{
+  struct sparse_bins *h;
+
+  check_alloc(h=(struct sparse_bins*)malloc(sizeof(struct sparse_bins)));
+  make_table(h,FIRST_BITS);
+  h->used=0;
+
+  return h;
+}
+
+void free_sparse_bins(struct sparse_bins *h)
+{
+  free(h->key);
+  free(h->count);
+  free(h);
+}
+
+static void grow(struct sparse_bins *h)
+{
+  unsigned long i,j,size=h->size,*key=h->key,*count=h->count;
+
+  make_table(h,h->bits+1);
+  for (i=0;i<size;i++)
+    if (key[i] != EMPTY) {
+      j=slot(h,key[i]);
+      h->key[j]=key[i];
+      h->count[j]=count[i];
+    }
+  free(key);
+  free(count);
+}
+
+void sparse_bins_add(struct sparse_bins *h,unsigned long key)
+{
+  unsigned long i;
+
+  i=slot(h,key);
+  if (h->key[i] == EMPTY) {
+    if (2*(h->used+1) > h->size) {
+      grow(h);
+      i=slot(h,key);
+    }
+    h->key[i]=key;
+    h->used++;
+  }
+  h->count[i]++;
+}
+
+/* the count of bin key, 0 if it was never hit */
+unsigned long sparse_bins_count(struct sparse_bins *h,unsigned long key)
+{
+  return h->count[slot(h,key)];
+}
+#undef EMPTY
+#undef FIRST_BITS
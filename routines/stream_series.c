@@ -0,0 +1,189 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: The streaming counterparts of get_series and get_multi_series.
+  Instead of returning the series they hand every row to put as soon as
+  it is read, so the caller needs no memory for the data itself.
+  They return the number of rows used.
+  The first_pass functions do the same and prepare second_pass to hand
+  the same rows over once more. Files are simply read again, whatever
+  can't be read twice (stdin, pipes) is spilled to a temporary file of
+  raw doubles on the way. In a batch no lines only skip the file, the
+  caller then gets no rows and gives the first pass back with
+  free_second_pass. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#define SPILL_ROWS 4096
+
+static void check_lines(unsigned long l,int code,unsigned int verbosity)
+{
+  if (l == 0) {
+    if (skip_batch_file("0 lines read"))
+      return;
+    fprintf(stderr,"0 lines read. It makes no sense to continue. Exiting!\n");
+    exit(code);
+  }
+  else {
+    if (verbosity&VER_INPUT)
+      fprintf(stderr,"Use %lu lines.\n",l);
+  }
+}
+
+unsigned long stream_series(char *name,unsigned long l,unsigned long ex,
+			    unsigned int col,row_function put,void *data,
+			    unsigned int verbosity)
+{
+  struct column_plan *plan;
+
+  plan=make_column_plan(&col,1);
+  l=stream_columns(name,l,ex,plan,put,data,NULL,verbosity);
+  free_column_plan(plan);
+  check_lines(l,GET_SERIES_NO_LINES,verbosity);
+
+  return l;
+}
+
+unsigned long stream_multi_series(char *name,unsigned long l,
+				  unsigned long ex,unsigned int *col,
+				  char *in_which,char colfix,
+				  row_function put,void *data,
+				  unsigned int verbosity)
+{
+  struct column_plan *plan;
+
+  plan=parse_column_string(in_which,col,colfix,verbosity);
+  l=stream_columns(name,l,ex,plan,put,data,"get_multi_series",verbosity);
+  free_column_plan(plan);
+  check_lines(l,GET_MULTI_SERIES_NO_LINES,verbosity);
+
+  return l;
+}
+
+/* writes each row to the spill file before handing it on */
+static void spill_row(double *val,unsigned int n,void *data)
+{
+  struct second_pass *p=(struct second_pass*)data;
+
+  if (fwrite(val,sizeof(double),(size_t)n,p->spill) != (size_t)n) {
+    fprintf(stderr,"Couldn't write the temporary file for the second"
+	    " pass. Exiting!\n");
+    exit(STREAM_SERIES_SPILL_FAILED);
+  }
+  p->put(val,n,p->data);
+}
+
+static struct second_pass *first_pass(char *name,unsigned long *l,
+				      unsigned long ex,
+				      struct column_plan *plan,
+				      row_function put,void *data,char *who,
+				      unsigned int verbosity)
+{
+  struct second_pass *p;
+  struct stat st;
+
+  check_alloc(p=(struct second_pass*)calloc((size_t)1,
+					     sizeof(struct second_pass)));
+  p->plan=plan;
+  p->ex=ex;
+  if ((name != NULL) && !stat(name,&st) && S_ISREG(st.st_mode)) {
+    p->name=name;
+    *l=stream_columns(name,*l,ex,plan,put,data,who,verbosity);
+  }
+  else {
+    if ((p->spill=tmpfile()) == NULL) {
+      fprintf(stderr,"Couldn't open a temporary file for the second"
+	      " pass. Exiting!\n");
+      exit(STREAM_SERIES_SPILL_FAILED);
+    }
+    p->put=put;
+    p->data=data;
+    *l=stream_columns(name,*l,ex,plan,spill_row,p,who,verbosity);
+    if (fflush(p->spill) != 0) {
+      fprintf(stderr,"Couldn't write the temporary file for the second"
+	      " pass. Exiting!\n");
+      exit(STREAM_SERIES_SPILL_FAILED);
+    }
+  }
+  p->l= *l;
+
+  return p;
+}
+
+struct second_pass *first_pass_series(char *name,unsigned long *l,
+				      unsigned long ex,unsigned int col,
+				      row_function put,void *data,
+				      unsigned int verbosity)
+{
+  struct second_pass *p;
+
+  p=first_pass(name,l,ex,make_column_plan(&col,1),put,data,NULL,verbosity);
+  check_lines(*l,GET_SERIES_NO_LINES,verbosity);
+
+  return p;
+}
+
+struct second_pass *first_pass_multi_series(char *name,unsigned long *l,
+					    unsigned long ex,
+					    unsigned int *col,char *in_which,
+					    char colfix,row_function put,
+					    void *data,unsigned int verbosity)
+{
+  struct second_pass *p;
+
+  p=first_pass(name,l,ex,parse_column_string(in_which,col,colfix,verbosity),
+	       put,data,"get_multi_series",verbosity);
+  check_lines(*l,GET_MULTI_SERIES_NO_LINES,verbosity);
+
+  return p;
+}
+
+/* hands the rows of the first pass to put once more and frees p */
+void second_pass(struct second_pass *p,row_function put,void *data)
+{
+  unsigned int n=p->plan->n;
+  unsigned long i,rows;
+  double *buf;
+
+  if (p->spill == NULL)
+    stream_columns(p->name,p->l,p->ex,p->plan,put,data,NULL,0);
+  else {
+    rewind(p->spill);
+    check_alloc(buf=(double*)malloc(sizeof(double)*n*SPILL_ROWS));
+    while ((rows=(unsigned long)fread(buf,sizeof(double)*n,
+				      (size_t)SPILL_ROWS,p->spill)) > 0)
+      for (i=0;i<rows;i++)
+	put(buf+i*n,n,data);
+    free(buf);
+  }
+  free_second_pass(p);
+}
+
+/* gives a first pass back without a second one */
+void free_second_pass(struct second_pass *p)
+{
+  if (p->spill != NULL)
+    fclose(p->spill);
+  free_column_plan(p->plan);
+  free(p);
+}
+#undef SPILL_ROWS
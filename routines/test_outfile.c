@@ -20,16 +20,21 @@
 /*Author: Rainer Hegger Last modified: Mar 20, 1999 */
 #include <stdio.h>
 #include <stdlib.h>
+#include "tsa.h"
 #include "tisean_cec.h"
 
-void test_outfile(char *name)
+/* 0 if a file of a batch can't be written, see skip_batch_file */
+int test_outfile(char *name)
 {
   FILE *file;
   
   file=fopen(name,"a");
   if (file == NULL) {
+    if (skip_batch_file("output can't be written"))
+      return 0;
     fprintf(stderr,"Couldn't open %s for writing. Exiting\n",name);
     exit(TEST_OUTFILE_NO_WRITE_ACCESS);
   }
   fclose(file);
+  return 1;
 }
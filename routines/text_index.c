@@ -0,0 +1,274 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Structural index of a block of text, after the first stage of
+  simdjson. Each 64 bytes are classified at once into a mask of
+  whitespace and a mask of newlines, with AVX2 or SSE2 where the
+  processor has them and byte by byte otherwise. Whitespace is what
+  isspace() says in the C locale. The readers then find line ends and
+  the start and end of fields by counting zero bits instead of testing
+  every character. Bits past the end of the text are set in both masks,
+  so searches stop there. count_newlines counts lines the same way
+  without building an index. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  defined(__SSE2__)
+#define HAVE_SSE2_INDEX
+#include <immintrin.h>
+#endif
+
+static int classify_bytes(char *p,unsigned long n,unsigned long long *space,
+			  unsigned long long *newline)
+{
+  unsigned long i;
+  unsigned long long s=0,nl=0;
+  unsigned char c;
+  int zero=0;
+
+  for (i=0;i<n;i++) {
+    c=(unsigned char)p[i];
+    s |= (unsigned long long)((c == ' ') || ((unsigned char)(c-9) < 5)) << i;
+    nl |= (unsigned long long)(c == '\n') << i;
+    zero |= (c == 0);
+  }
+  *space=s;
+  *newline=nl;
+
+  return zero;
+}
+
+#ifdef HAVE_SSE2_INDEX
+static int classify_sse2(char *p,unsigned long long *space,
+			 unsigned long long *newline)
+{
+  __m128i x,t,blank=_mm_set1_epi8(' '),nl=_mm_set1_epi8('\n');
+  __m128i tab=_mm_set1_epi8(9),four=_mm_set1_epi8(4),zero=_mm_setzero_si128();
+  unsigned long long s=0,n=0,z=0;
+  int k;
+
+  for (k=0;k<4;k++) {
+    x=_mm_loadu_si128((__m128i*)(p+16*k));
+    /* 9..13 are the bytes whose distance from 9 is at most 4 unsigned */
+    t=_mm_sub_epi8(x,tab);
+    t=_mm_or_si128(_mm_cmpeq_epi8(x,blank),
+		   _mm_cmpeq_epi8(_mm_min_epu8(t,four),t));
+    s |= (unsigned long long)(unsigned int)_mm_movemask_epi8(t) << (16*k);
+    n |= (unsigned long long)(unsigned int)
+      _mm_movemask_epi8(_mm_cmpeq_epi8(x,nl)) << (16*k);
+    z |= (unsigned long long)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x,zero));
+  }
+  *space=s;
+  *newline=n;
+
+  return z != 0;
+}
+
+__attribute__((target("avx2")))
+static int classify_avx2(char *p,unsigned long long *space,
+			 unsigned long long *newline)
+{
+  __m256i x,t,blank=_mm256_set1_epi8(' '),nl=_mm256_set1_epi8('\n');
+  __m256i tab=_mm256_set1_epi8(9),four=_mm256_set1_epi8(4);
+  __m256i zero=_mm256_setzero_si256();
+  unsigned long long s=0,n=0,z=0;
+  int k;
+
+  for (k=0;k<2;k++) {
+    x=_mm256_loadu_si256((__m256i*)(p+32*k));
+    t=_mm256_sub_epi8(x,tab);
+    t=_mm256_or_si256(_mm256_cmpeq_epi8(x,blank),
+		      _mm256_cmpeq_epi8(_mm256_min_epu8(t,four),t));
+    s |= (unsigned long long)(unsigned int)_mm256_movemask_epi8(t) << (32*k);
+    n |= (unsigned long long)(unsigned int)
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(x,nl)) << (32*k);
+    z |= (unsigned long long)(unsigned int)
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(x,zero));
+  }
+  *space=s;
+  *newline=n;
+
+  return z != 0;
+}
+#endif
+
+struct text_index *make_text_index(void)
+{
+  struct text_index *ix;
+
+  check_alloc(ix=(struct text_index*)calloc((size_t)1,
+					    sizeof(struct text_index)));
+  return ix;
+}
+
+void free_text_index(struct text_index *ix)
+{
+  if (ix->space != NULL)
+    free(ix->space);
+  if (ix->newline != NULL)
+    free(ix->newline);
+  free(ix);
+}
+
+/* classifies the len bytes at text */
+void index_text(char *text,unsigned long len,struct text_index *ix)
+{
+  unsigned long w,full,rest;
+  int zero=0;
+  ix->text=text;
+  ix->len=len;
+  /* one more word than needed, so there are always bits past the end */
+  ix->words=len/64+1;
+  if (ix->words > ix->max_words) {
+    ix->max_words=ix->words;
+    check_alloc(ix->space=(unsigned long long*)
+		realloc(ix->space,sizeof(unsigned long long)*ix->max_words));
+    check_alloc(ix->newline=(unsigned long long*)
+		realloc(ix->newline,sizeof(unsigned long long)*ix->max_words));
+  }
+
+  full=len/64;
+#ifdef HAVE_SSE2_INDEX
+  if (__builtin_cpu_supports("avx2")) {
+    for (w=0;w<full;w++)
+      zero |= classify_avx2(text+64*w,ix->space+w,ix->newline+w);
+  }
+  else {
+    for (w=0;w<full;w++)
+      zero |= classify_sse2(text+64*w,ix->space+w,ix->newline+w);
+  }
+#else
+  for (w=0;w<full;w++)
+    zero |= classify_bytes(text+64*w,64,ix->space+w,ix->newline+w);
+#endif
+  rest=len-64*full;
+  zero |= classify_bytes(text+64*full,rest,ix->space+full,ix->newline+full);
+  ix->space[full] |= ~0ULL << rest;
+  ix->newline[full] |= ~0ULL << rest;
+  ix->zero=zero;
+}
+
+#ifdef HAVE_SSE2_INDEX
+__attribute__((target("avx2,popcnt")))
+static unsigned long count_avx2(char *p,unsigned long len)
+{
+  __m256i nl=_mm256_set1_epi8('\n');
+  unsigned long i,n=0;
+
+  for (i=0;i+32 <= len;i += 32)
+    n += (unsigned long)__builtin_popcount((unsigned int)_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)(p+i)),nl)));
+  for (;i<len;i++)
+    n += (p[i] == '\n');
+  return n;
+}
+
+static unsigned long count_sse2(char *p,unsigned long len)
+{
+  __m128i nl=_mm_set1_epi8('\n');
+  unsigned long i,n=0;
+
+  for (i=0;i+16 <= len;i += 16)
+    n += (unsigned long)__builtin_popcount((unsigned int)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)(p+i)),nl)));
+  for (;i<len;i++)
+    n += (p[i] == '\n');
+  return n;
+}
+#endif
+
+/* number of newlines in the len bytes at p */
+unsigned long count_newlines(char *p,unsigned long len)
+{
+#ifdef HAVE_SSE2_INDEX
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    return count_avx2(p,len);
+  return count_sse2(p,len);
+#else
+  unsigned long i,n=0;
+
+  for (i=0;i<len;i++)
+    n += (p[i] == '\n');
+  return n;
+#endif
+}
+
+static int lowest_bit(unsigned long long b)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(b);
+#else
+  int i=0;
+
+  while (!(b&1ULL)) {
+    b >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/* position of the first set bit at or after i; there always is one */
+static unsigned long next_set(unsigned long long *m,unsigned long i)
+{
+  unsigned long w=i>>6;
+  unsigned long long b=m[w]&(~0ULL << (i&63));
+
+  while (b == 0)
+    b=m[++w];
+  return (w<<6)+(unsigned long)lowest_bit(b);
+}
+
+/* position of the first clear bit in [i,end), or end */
+static unsigned long next_clear(unsigned long long *m,unsigned long i,
+				unsigned long end)
+{
+  unsigned long w=i>>6,last=end>>6;
+  unsigned long long b=~m[w]&(~0ULL << (i&63));
+
+  while ((b == 0) && (w < last))
+    b= ~m[++w];
+  if (b == 0)
+    return end;
+  i=(w<<6)+(unsigned long)lowest_bit(b);
+  return (i < end) ? i : end;
+}
+
+/* position of the first newline at or after i, or the length of the text */
+unsigned long next_newline(struct text_index *ix,unsigned long i)
+{
+  unsigned long j=next_set(ix->newline,i);
+
+  return (j < ix->len) ? j : ix->len;
+}
+
+/* the next field starting at or after *i in [*i,end): its start is
+   returned and *i is set to its end. Returns end if there is none */
+unsigned long next_field(struct text_index *ix,unsigned long *i,
+			 unsigned long end)
+{
+  unsigned long start;
+
+  if ((start=next_clear(ix->space,*i,end)) < end)
+    *i=next_set(ix->space,start);
+  return start;
+}
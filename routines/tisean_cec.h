@@ -41,6 +41,9 @@
 #define GET_MULTI_SERIES_NO_LINES 22
 #define VARIANCE_VAR_EQ_ZERO 23
 #define CHECK_OPTION_NOT_THREE 25
+#define BINARY_COLUMNS_WRONG_FORMAT 26
+#define STREAM_SERIES_SPILL_FAILED 27
+#define READ_COLUMNS_READ_FAILED 28
 
 /* These are the codes for the main routines */
 #define HISTOGRAM__MINMAX_MISSING_OR_WRONG_FORMAT 90
@@ -36,6 +36,136 @@
 /* Uncomment the variable to get rid of the initial Version message */
 /*#define OMIT_WHAT_I_DO*/
 
+/* Sorted list of the columns a reader has to convert, see scan_columns.c */
+struct column_plan {
+  unsigned int n;      /* number of requested columns */
+  unsigned int *col;   /* requested columns in ascending order */
+  unsigned int *slot;  /* position of col[i] in the request */
+};
+
+/* Header of the binary column files, see binary_columns.c */
+#define BINARY_MAGIC "TISEANB1"
+#define BINARY_NAME_SIZE 32
+struct binary_header {
+  char magic[8];
+  unsigned int byteorder;   /* 0x01020304 as seen by the writer */
+  unsigned int name_size;   /* bytes reserved per column name */
+  unsigned long long cols,rows;
+  unsigned long long data;  /* offset of the first column */
+  unsigned long long flags;
+};
+/* flags: the columns are followed by one column_stats per column.
+   0x1 marked the sums of earlier files, which are no longer read */
+#define BINARY_HAS_STATS 0x2ULL
+
+/* Where the numbers of a mapped array file are, see array_files.c */
+struct array_layout {
+  char *data;                   /* row 0, column 0 */
+  unsigned long rows,cols;
+  unsigned int size;            /* 4 for float32, 8 for float64 */
+  unsigned long row_step,col_step;  /* bytes to the next row/column */
+};
+
+/* Statistics of a whole column as stored in binary column files */
+struct column_stats {
+  double min,max;
+  double mean,m2;               /* m2 is the sum of squared deviations */
+};
+
+/* Statistics of a column, see moments.c */
+struct moments {
+  double min,max;
+  double mean,var;              /* var is the population variance */
+};
+
+/* Growing 1-d or 2-d bins of the streaming modes, see bin_grid.c */
+struct bin_grid {
+  unsigned int dim;
+  char sums;              /* whether sum and sumsq are kept */
+  long lo[2];             /* index of the first bin held per dimension */
+  unsigned long n[2];     /* number of bins held per dimension */
+  unsigned long *count;
+  double *sum,*sumsq;
+  double *csum,*csumsq;   /* the rounding errors of sum and sumsq */
+  struct edge_value *edge;  /* values close below a bin edge */
+  unsigned long nedge,hash_size,*hash;
+};
+
+/* Histogram of a stream with a range that doubles as needed,
+   see doubling_bins.c */
+struct doubling_bins {
+  unsigned long n;        /* number of bins */
+  double lo,width;        /* the bins cover [lo,lo+n*width) */
+  unsigned long *count;
+  double *first;          /* the first n values, until the range is set */
+  unsigned long nfirst;
+};
+
+/* Counts of the few bins hit out of very many, see sparse_bins.c */
+struct sparse_bins {
+  unsigned long size,used;  /* slots, of them in use */
+  unsigned int bits;        /* size is 2^bits */
+  unsigned long *key;       /* the bin of each slot, ULONG_MAX if empty */
+  unsigned long *count;
+};
+
+/* Where values go in a 1d histogram, see bin_kernel.c. The bin of x is
+   (long)((x-min)*base/interval+offset) */
+struct bin_scale {
+  double min,base,interval,offset;
+  unsigned long range;          /* the bins are 0..range-1 */
+  int edge;                     /* what happens to the bins outside */
+};
+#define BIN_DROP 0              /* they are not counted */
+#define BIN_FOLD 1              /* bin range goes to range-1, others drop */
+#define BIN_CLAMP 2             /* all of them go to range-1 */
+
+/* Receives the rows of a streaming reader one after the other */
+typedef void (*row_function)(double *,unsigned int,void *);
+/* Called by run_batch with a data file of the batch, see batch.c */
+typedef void (*batch_function)(char *,void *);
+/* Counts the values first..last-1 into the bins box, see parallel_bins.c */
+typedef void (*bin_slice)(unsigned long,unsigned long,long *,void *);
+
+/* What second_pass needs to read the rows of a first pass again */
+struct second_pass {
+  char *name;             /* file to read again, unless spilled */
+  unsigned long l,ex;
+  struct column_plan *plan;
+  FILE *spill;            /* rows read from a stream, NULL for files */
+  row_function put;       /* the first pass' sink while spilling */
+  void *data;
+};
+
+/* Lines of a stream as views into a growing buffer, see line_scanner.c */
+struct line_scanner {
+  FILE *fin;
+  struct uring_reader *uring;   /* read from here instead of fin if set */
+  struct decompressor *unpack;  /* or from here */
+  char *buf;
+  unsigned long size;
+  unsigned long start,end;      /* the unread bytes are buf[start,end) */
+  unsigned long scanned;        /* buf[start,scanned) holds no newline */
+  char eof;
+};
+
+/* Whitespace and newline masks of a text, 64 bytes per word,
+   see text_index.c */
+struct text_index {
+  char *text;
+  unsigned long len;
+  unsigned long long *space,*newline;
+  unsigned long words,max_words;
+  char zero;                    /* whether the text holds a '\0' */
+};
+
+/* Tells whether a file next to an input still belongs to it,
+   see sidecar.c */
+struct sidecar_key {
+  unsigned long long size;
+  long long mtime,mtime_nsec;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -45,10 +175,150 @@ extern double *get_series(char *,unsigned long *,unsigned long,
 		       unsigned int,unsigned int);
 extern double **get_multi_series(char *,unsigned long *,unsigned long,
 				 unsigned int *,char *,char,unsigned int);
+extern unsigned long stream_series(char *,unsigned long,unsigned long,
+				   unsigned int,row_function,void *,
+				   unsigned int);
+extern unsigned long stream_multi_series(char *,unsigned long,unsigned long,
+					 unsigned int *,char *,char,
+					 row_function,void *,unsigned int);
+extern struct second_pass *first_pass_series(char *,unsigned long *,
+					    unsigned long,unsigned int,
+					    row_function,void *,unsigned int);
+extern struct second_pass *first_pass_multi_series(char *,unsigned long *,
+						  unsigned long,
+						  unsigned int *,char *,char,
+						  row_function,void *,
+						  unsigned int);
+extern void second_pass(struct second_pass *,row_function,void *);
+extern void free_second_pass(struct second_pass *);
+extern struct column_plan *parse_column_string(char *,unsigned int *,char,
+					       unsigned int);
+extern struct column_plan *make_column_plan(unsigned int *,unsigned int);
+extern void free_column_plan(struct column_plan *);
+extern int parse_double(char *,unsigned long,double *);
+extern int is_number(char *,unsigned long);
+extern int scan_columns(char *,char *,struct column_plan *,double *);
+extern int scan_indexed_columns(struct text_index *,unsigned long,
+				unsigned long,struct column_plan *,double *);
+extern struct text_index *make_text_index(void);
+extern void free_text_index(struct text_index *);
+extern void index_text(char *,unsigned long,struct text_index *);
+extern unsigned long next_newline(struct text_index *,unsigned long);
+extern unsigned long count_newlines(char *,unsigned long);
+extern unsigned long next_field(struct text_index *,unsigned long *,
+				unsigned long);
+extern void set_input_files(char *,char **,unsigned int);
+extern char **input_files(char *,unsigned int *);
+extern char *current_input_file(void);
+extern double **read_input_files(unsigned long *,unsigned long,
+				 struct column_plan *,char *,unsigned int);
+extern unsigned long stream_input_files(unsigned long,unsigned long,
+					struct column_plan *,row_function,
+					void *,char *,unsigned int);
+extern double **read_columns(char *,unsigned long *,unsigned long,
+			     struct column_plan *,char *,unsigned int);
+extern unsigned long stream_columns(char *,unsigned long,unsigned long,
+				    struct column_plan *,row_function,void *,
+				    char *,unsigned int);
+extern unsigned long count_lines(char *);
+extern struct uring_reader *open_uring_reader(char *,unsigned long);
+extern unsigned long uring_read(struct uring_reader *,char *,unsigned long);
+extern void close_uring_reader(struct uring_reader *);
+extern struct decompressor *open_decompressor(char *,char *,unsigned long);
+extern unsigned long decompress_read(struct decompressor *,char *,
+				     unsigned long);
+extern void close_decompressor(struct decompressor *);
+extern struct line_scanner *make_line_scanner(FILE *,struct uring_reader *,
+					      struct decompressor *,
+					      unsigned long);
+extern void free_line_scanner(struct line_scanner *);
+extern char *scan_line(struct line_scanner *,unsigned long *);
+extern char *scan_block(struct line_scanner *,char **,unsigned long *,
+			unsigned long *);
+extern int sidecar_wanted(char *);
+extern char *sidecar_name(char *,char *);
+extern int sidecar_key(char *,struct sidecar_key *);
+extern FILE *create_sidecar(char *,char **);
+extern int finish_sidecar(FILE *,char *,char *,int);
+extern unsigned long line_offset(char *,char *,unsigned long,unsigned long,
+				 unsigned int);
+extern int read_cached(char *,char *,unsigned long,unsigned long,
+		       unsigned long,struct column_plan *,row_function,void *,
+		       char *,unsigned int,unsigned long *);
+extern void print_first_line(char *,double *,unsigned int);
+extern void print_ignored(unsigned long,char *,unsigned long);
+extern void sample_lines(unsigned long,unsigned long);
+extern unsigned long sample_stride(void);
+extern unsigned long sample_size(void);
+extern void sample_given(unsigned long *,unsigned long);
+extern unsigned long *sample_indices(unsigned long,unsigned long,
+				     unsigned long *);
+extern unsigned long read_sample(char *,unsigned long,struct line_scanner *,
+				 unsigned long,unsigned long,
+				 struct column_plan *,row_function,void *,
+				 char *,unsigned int);
+extern unsigned long read_pipeline(char *,unsigned long,FILE *,
+				   struct uring_reader *,struct decompressor *,
+				   unsigned long,unsigned long,unsigned long,
+				   struct column_plan *,row_function,void *,
+				   char *,unsigned int);
+extern char *map_file(char *,unsigned long *);
+extern void unmap_file(char *,unsigned long);
+extern int is_binary_file(char *,unsigned long);
+extern struct binary_header *check_binary_file(char *,char *,unsigned long);
+extern int array_layout(char *,char *,unsigned long,struct array_layout *);
+extern double array_element(struct array_layout *,unsigned long,
+			    unsigned long);
+extern void check_array_columns(char *,struct array_layout *,
+				struct column_plan *);
+extern double **map_array_columns(char *,char *,unsigned long,
+				  struct array_layout *,unsigned long *,
+				  unsigned long,struct column_plan *,
+				  unsigned int);
+extern void write_binary_columns(char *,double **,unsigned int,
+				 unsigned long,char **);
+extern int stored_stats(double *,unsigned long,struct column_stats *);
+extern void free_series(double *);
+extern void free_multi_series(double **,unsigned int);
+extern struct bin_grid *make_bin_grid(unsigned int,char);
+extern void free_bin_grid(struct bin_grid *);
+extern long bin_grid_index(struct bin_grid *,long *);
+extern void bin_grid_add(struct bin_grid *,double *,double);
+extern void bin_indices(double *,unsigned long,struct bin_scale *,
+			unsigned long *);
+extern void bin_count(double *,unsigned long,struct bin_scale *,long *);
+extern void parallel_bins(unsigned long,unsigned long,bin_slice,void *,
+			  long *);
+extern void parallel_bin_count(double *,unsigned long,struct bin_scale *,
+			       long *);
+extern void bin_grid_finish(struct bin_grid *,long *,long *);
+extern struct doubling_bins *make_doubling_bins(unsigned long);
+extern void free_doubling_bins(struct doubling_bins *);
+extern int doubling_bins_add(struct doubling_bins *,double);
+extern void doubling_bins_finish(struct doubling_bins *);
+extern struct sparse_bins *make_sparse_bins(void);
+extern void free_sparse_bins(struct sparse_bins *);
+extern void sparse_bins_add(struct sparse_bins *,unsigned long);
+extern unsigned long sparse_bins_count(struct sparse_bins *,unsigned long);
 extern void variance(double *,unsigned long,double *,double *);
+extern void stats_variance(struct column_stats *,unsigned long,double *,
+			   double *);
+extern void stats_add(struct column_stats *,unsigned long,double);
+extern void stats_moments(struct column_stats *,unsigned long,
+			  struct moments *);
+extern void column_statistics(double **,unsigned int,unsigned long,
+			      struct column_stats *);
+extern void column_moments(double **,unsigned int,unsigned long,
+			   struct moments *);
+extern int moments_variance(struct moments *,double *,double *);
 extern char* search_datafile(int, char**,unsigned int*,unsigned int);
+extern char **search_datafiles(int,char **,unsigned int *,unsigned int,
+			       unsigned int *);
+extern void run_batch(unsigned int,char **,batch_function,void *);
+extern int skip_batch_file(char *);
+extern long thread_budget(void);
 extern char* check_option(char**,int,int,int);
-extern void test_outfile(char*);
+extern int test_outfile(char*);
 
 extern void check_alloc(void *);
 extern char* myfgets(char *,int *,FILE *,unsigned int);
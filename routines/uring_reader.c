@@ -0,0 +1,273 @@
+/*
+ *   This file is part of TISEAN
+ *
+ *   Copyright (c) 1998-2007 Rainer Hegger, Holger Kantz, Thomas Schreiber
+ *
+ *   TISEAN is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   TISEAN is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with TISEAN; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*Note: Reads a file with io_uring, keeping URING_DEPTH reads of
+  URING_BLOCK bytes in flight. uring_read copies the completed blocks out
+  in file order and queues the next read into every block it empties.
+  The kernel interface is used directly, so no library is needed.
+  open_uring_reader returns NULL if io_uring isn't available, on other
+  systems it always does. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsa.h"
+#include "tisean_cec.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#define URING_DEPTH 8
+#define URING_BLOCK (1UL<<20)
+
+#define IDLE 0
+#define IN_FLIGHT 1
+#define DONE 2
+
+struct uring_reader {
+  int fd,ring;
+  unsigned long long size,next;   /* file size, offset of the next read */
+  unsigned int *sq_tail,*sq_mask,*sq_array;
+  unsigned int *cq_head,*cq_tail,*cq_mask;
+  struct io_uring_sqe *sqe;
+  struct io_uring_cqe *cqe;
+  void *sq_ring,*cq_ring;
+  size_t sq_size,cq_size,sqe_size;
+  char *buf[URING_DEPTH];
+  struct iovec iov[URING_DEPTH];
+  unsigned long long off[URING_DEPTH];
+  unsigned long want[URING_DEPTH],got[URING_DEPTH];
+  char state[URING_DEPTH];
+  unsigned int cur;               /* block handed out next */
+  unsigned long pos;              /* bytes of it handed out already */
+};
+
+static int uring_enter(int ring,unsigned int submit,unsigned int wait)
+{
+  return (int)syscall(__NR_io_uring_enter,ring,submit,wait,
+		      wait ? IORING_ENTER_GETEVENTS : 0,NULL,0);
+}
+
+/* queues the read of the rest of block i */
+static void submit(struct uring_reader *u,unsigned int i)
+{
+  unsigned int tail;
+  struct io_uring_sqe *e;
+
+  tail= *u->sq_tail;
+  e= &u->sqe[tail&*u->sq_mask];
+  memset(e,0,sizeof(struct io_uring_sqe));
+  u->iov[i].iov_base=u->buf[i]+u->got[i];
+  u->iov[i].iov_len=(size_t)(u->want[i]-u->got[i]);
+  e->opcode=IORING_OP_READV;
+  e->fd=u->fd;
+  e->off=u->off[i]+u->got[i];
+  e->addr=(unsigned long)&u->iov[i];
+  e->len=1;
+  e->user_data=i;
+  u->sq_array[tail&*u->sq_mask]=tail&*u->sq_mask;
+  __atomic_store_n(u->sq_tail,tail+1,__ATOMIC_RELEASE);
+  u->state[i]=IN_FLIGHT;
+  if (uring_enter(u->ring,1,0) < 0) {
+    fprintf(stderr,"io_uring_enter failed. Exiting!\n");
+    exit(READ_COLUMNS_READ_FAILED);
+  }
+}
+
+/* starts the next read of the file into block i if there is one */
+static void next_read(struct uring_reader *u,unsigned int i)
+{
+  if (u->next >= u->size) {
+    u->state[i]=IDLE;
+    return;
+  }
+  u->off[i]=u->next;
+  u->want[i]=(u->size-u->next < URING_BLOCK) ?
+    (unsigned long)(u->size-u->next) : URING_BLOCK;
+  u->got[i]=0;
+  u->next += u->want[i];
+  submit(u,i);
+}
+
+static void reap(struct uring_reader *u)
+{
+  unsigned int head,i;
+  int res;
+
+  if (uring_enter(u->ring,0,1) < 0) {
+    fprintf(stderr,"io_uring_enter failed. Exiting!\n");
+    exit(READ_COLUMNS_READ_FAILED);
+  }
+  head= *u->cq_head;
+  while (head != __atomic_load_n(u->cq_tail,__ATOMIC_ACQUIRE)) {
+    i=(unsigned int)u->cqe[head&*u->cq_mask].user_data;
+    res=u->cqe[head&*u->cq_mask].res;
+    head++;
+    if (res < 0) {
+      fprintf(stderr,"Reading the input failed: %s. Exiting!\n",
+	      strerror(-res));
+      exit(READ_COLUMNS_READ_FAILED);
+    }
+    u->got[i] += (unsigned long)res;
+    if ((res == 0) || (u->got[i] == u->want[i]))
+      u->state[i]=DONE;
+    else
+      submit(u,i);
+  }
+  __atomic_store_n(u->cq_head,head,__ATOMIC_RELEASE);
+}
+
+/* reads name from byte start on */
+struct uring_reader *open_uring_reader(char *name,unsigned long start)
+{
+  struct uring_reader *u;
+  struct io_uring_params p;
+  struct stat st;
+  unsigned int i;
+  char *sq,*cq;
+
+  check_alloc(u=(struct uring_reader*)calloc((size_t)1,
+					     sizeof(struct uring_reader)));
+  if ((u->fd=open(name,O_RDONLY)) < 0) {
+    free(u);
+    return NULL;
+  }
+  memset(&p,0,sizeof(p));
+  if ((fstat(u->fd,&st) != 0) ||
+      ((u->ring=(int)syscall(__NR_io_uring_setup,URING_DEPTH,&p)) < 0)) {
+    close(u->fd);
+    free(u);
+    return NULL;
+  }
+  u->size=(unsigned long long)st.st_size;
+  u->next=start;
+
+  u->sq_size=p.sq_off.array+p.sq_entries*sizeof(unsigned int);
+  u->cq_size=p.cq_off.cqes+p.cq_entries*sizeof(struct io_uring_cqe);
+  u->sqe_size=p.sq_entries*sizeof(struct io_uring_sqe);
+  if (p.features&IORING_FEAT_SINGLE_MMAP) {
+    if (u->cq_size > u->sq_size)
+      u->sq_size=u->cq_size;
+    u->cq_size=0;
+  }
+  u->sq_ring=mmap(NULL,u->sq_size,PROT_READ|PROT_WRITE,
+		  MAP_SHARED|MAP_POPULATE,u->ring,IORING_OFF_SQ_RING);
+  u->cq_ring=(u->cq_size == 0) ? u->sq_ring :
+    mmap(NULL,u->cq_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,
+	 u->ring,IORING_OFF_CQ_RING);
+  u->sqe=(struct io_uring_sqe*)
+    mmap(NULL,u->sqe_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,
+	 u->ring,IORING_OFF_SQES);
+  if ((u->sq_ring == MAP_FAILED) || (u->cq_ring == MAP_FAILED) ||
+      (u->sqe == MAP_FAILED)) {
+    fprintf(stderr,"Couldn't map the io_uring rings. Exiting!\n");
+    exit(READ_COLUMNS_READ_FAILED);
+  }
+  sq=(char*)u->sq_ring;
+  cq=(char*)u->cq_ring;
+  u->sq_tail=(unsigned int*)(sq+p.sq_off.tail);
+  u->sq_mask=(unsigned int*)(sq+p.sq_off.ring_mask);
+  u->sq_array=(unsigned int*)(sq+p.sq_off.array);
+  u->cq_head=(unsigned int*)(cq+p.cq_off.head);
+  u->cq_tail=(unsigned int*)(cq+p.cq_off.tail);
+  u->cq_mask=(unsigned int*)(cq+p.cq_off.ring_mask);
+  u->cqe=(struct io_uring_cqe*)(cq+p.cq_off.cqes);
+
+  for (i=0;i<URING_DEPTH;i++) {
+    check_alloc(u->buf[i]=(char*)malloc((size_t)URING_BLOCK));
+    next_read(u,i);
+  }
+  return u;
+}
+
+/* copies the next at most want bytes of the file to dst, returns how
+   many, 0 only at the end of the file */
+unsigned long uring_read(struct uring_reader *u,char *dst,unsigned long want)
+{
+  unsigned long n,done=0;
+  unsigned int i;
+
+  while (done < want) {
+    i=u->cur;
+    if (u->state[i] == IDLE)
+      break;
+    while (u->state[i] == IN_FLIGHT)
+      reap(u);
+    n=u->got[i]-u->pos;
+    if (n > want-done)
+      n=want-done;
+    memcpy(dst+done,u->buf[i]+u->pos,(size_t)n);
+    done += n;
+    u->pos += n;
+    if (u->pos == u->got[i]) {
+      if (u->got[i] < u->want[i])
+	u->next=u->size;    /* the file got shorter while reading */
+      u->pos=0;
+      next_read(u,i);
+      u->cur=(i+1)%URING_DEPTH;
+    }
+  }
+  return done;
+}
+
+void close_uring_reader(struct uring_reader *u)
+{
+  unsigned int i;
+
+  /* the kernel may still write into blocks that are in flight */
+  for (i=0;i<URING_DEPTH;i++)
+    while (u->state[i] == IN_FLIGHT)
+      reap(u);
+  for (i=0;i<URING_DEPTH;i++)
+    free(u->buf[i]);
+  munmap(u->sqe,u->sqe_size);
+  if (u->cq_ring != u->sq_ring)
+    munmap(u->cq_ring,u->cq_size);
+  munmap(u->sq_ring,u->sq_size);
+  close(u->ring);
+  close(u->fd);
+  free(u);
+}
+#undef URING_DEPTH
+#undef URING_BLOCK
+#undef IDLE
+#undef IN_FLIGHT
+#undef DONE
+
+#else
+
+struct uring_reader *open_uring_reader(char *name,unsigned long start)
+{
+  return NULL;
+}
+
+unsigned long uring_read(struct uring_reader *u,char *dst,unsigned long want)
+{
+  return 0;
+}
+
+void close_uring_reader(struct uring_reader *u)
+{
+}
+#endif
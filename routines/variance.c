@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include "tsa.h"
 #include "tisean_cec.h"
 
 void variance(double *s,unsigned long l,double *av,double *var)
@@ -43,3 +44,33 @@ void variance(double *s,unsigned long l,double *av,double *var)
   }
 }
 
+
+/* the same as variance for statistics that are already known */
+void stats_variance(struct column_stats *st,unsigned long l,double *av,
+		    double *var)
+{
+  *av=st->mean;
+  *var=sqrt(st->m2/(double)l);
+  if (*var == 0.0) {
+    fprintf(stderr,"Variance of the data is zero. Exiting!\n\n");
+    exit(VARIANCE_VAR_EQ_ZERO);
+  }
+}
+
+/* adds x as value number n+1 to statistics that are built while reading.
+   The mean and m2 are updated as by Welford, so the variance doesn't
+   lose precision to the square of the mean */
+void stats_add(struct column_stats *st,unsigned long n,double x)
+{
+  double d;
+
+  if (n == 0) {
+    st->min=st->max=x;
+    st->mean=st->m2=0.0;
+  }
+  else if (x < st->min) st->min=x;
+  else if (x > st->max) st->max=x;
+  d=x-st->mean;
+  st->mean += d/(double)(n+1);
+  st->m2 += d*(x-st->mean);
+}
@@ -0,0 +1,197 @@
+/*Author: Bjoern Bastian.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "routines/tsa.h"
+
+#define WID_STR "Converts columns of a text file into a binary column file"
+
+unsigned long length=ULONG_MAX;
+unsigned long exclude=0;
+unsigned int dim=1;
+char *columns=NULL,dimset=0;
+char *names=NULL;
+unsigned int verbosity=0xff;
+char *outfile=NULL;
+char *infile=NULL;
+
+void show_options(char *progname)
+{
+  what_i_do(progname,WID_STR);
+  fprintf(stderr," Usage: %s [options]\n",progname);
+  fprintf(stderr," options:\n");
+  fprintf(stderr,"Everything not being a valid option will be interpreted as a"
+          " possible datafile.\nIf no datafile is given stdin is read. "
+          " Just - also means stdin\n");
+  fprintf(stderr,"The binary file can be given to all programs instead of"
+          " the text file.\n");
+  fprintf(stderr,"\t-l # of lines to use [default is whole file]\n");
+  fprintf(stderr,"\t-x # of lines to ignore [default %ld]\n",exclude);
+  fprintf(stderr,"\t-m # of components to be read [default all columns of"
+          " the first data line, %u for stdin]\n",dim);
+  fprintf(stderr,"\t-c column selection [default 1,...,# of components]\n");
+  fprintf(stderr,"\t-n name,name,... column names [default original column"
+          " numbers]\n");
+  fprintf(stderr,"\t-o output file [default 'datafile'.bin]\n");
+  fprintf(stderr,"\t-V verbosity level [default 1]\n\t\t"
+          "0='only panic messages'\n\t\t"
+          "1='+ input/output messages'\n");
+  fprintf(stderr,"\t-h show these options\n");
+  exit(0);
+}
+
+void scan_options(int n,char **argv)
+{
+  char *out;
+
+  if ((out=check_option(argv,n,'l','u')) != NULL)
+    sscanf(out,"%lu",&length);
+  if ((out=check_option(argv,n,'x','u')) != NULL)
+    sscanf(out,"%lu",&exclude);
+  if ((out=check_option(argv,n,'m','u')) != NULL) {
+    sscanf(out,"%u",&dim);
+    dimset=1;
+  }
+  if ((out=check_option(argv,n,'c','s')) != NULL)
+    columns=out;
+  if ((out=check_option(argv,n,'n','s')) != NULL)
+    names=out;
+  if ((out=check_option(argv,n,'V','u')) != NULL)
+    sscanf(out,"%u",&verbosity);
+  if ((out=check_option(argv,n,'o','o')) != NULL) {
+    if (strlen(out) > 0)
+      outfile=out;
+  }
+}
+
+/* number of fields of the first line consisting of numbers only */
+unsigned int count_columns(char *name)
+{
+  char *input,*p,*rest;
+  unsigned int n=0;
+  unsigned long i,len;
+  FILE *fin;
+  struct line_scanner *scan;
+
+  fin=fopen(name,"r");
+  scan=make_line_scanner(fin,NULL,NULL,INPUT_SIZE);
+  for (i=0;i<exclude;i++)
+    if (scan_line(scan,&len) == NULL)
+      break;
+  while ((n == 0) && ((input=scan_line(scan,&len)) != NULL))
+    for (p=input;;) {
+      while (isspace((unsigned char)*p))
+        p++;
+      if (*p == '\0')
+        break;
+      strtod(p,&rest);
+      if ((rest == p) || !((*rest == '\0') || isspace((unsigned char)*rest))) {
+        n=0;
+        break;
+      }
+      n++;
+      p=rest;
+    }
+  free_line_scanner(scan);
+  fclose(fin);
+
+  return (n > 0) ? n : 1;
+}
+
+int main(int argc,char **argv)
+{
+  char stdi=0;
+  char **cname,*hname,*comma;
+  unsigned int i,*hcol,maxcol=0;
+  double **series;
+
+  if (scan_help(argc,argv))
+    show_options(argv[0]);
+
+  scan_options(argc,argv);
+#ifndef OMIT_WHAT_I_DO
+  if (verbosity&VER_INPUT)
+    what_i_do(argv[0],WID_STR);
+#endif
+
+  infile=search_datafile(argc,argv,NULL,verbosity);
+  if (infile == NULL)
+    stdi=1;
+
+  if (outfile == NULL) {
+    if (!stdi) {
+      check_alloc(outfile=calloc(strlen(infile)+5,(size_t)1));
+      sprintf(outfile,"%s.bin",infile);
+    }
+    else {
+      check_alloc(outfile=calloc((size_t)10,(size_t)1));
+      sprintf(outfile,"stdin.bin");
+    }
+  }
+  test_outfile(outfile);
+
+  if (!dimset && (columns == NULL) && !stdi) {
+    dim=count_columns(infile);
+    dimset=1;
+  }
+
+  if (columns == NULL)
+    series=(double**)get_multi_series(infile,&length,exclude,&dim,"",dimset,
+                                      verbosity);
+  else
+    series=(double**)get_multi_series(infile,&length,exclude,&dim,columns,
+                                      dimset,verbosity);
+
+  /* default names are the column numbers of the text file */
+  check_alloc(hcol=(unsigned int*)malloc(sizeof(unsigned int)*dim));
+  for (i=0;i<dim;i++)
+    hcol[i]=i+1;
+  if (columns != NULL) {
+    hname=columns;
+    for (i=0;(i<dim) && (*hname != '\0');i++) {
+      sscanf(hname,"%u",&hcol[i]);
+      if (hcol[i] > maxcol)
+        maxcol=hcol[i];
+      while (*hname && (*hname != ','))
+        hname++;
+      if (*hname == ',')
+        hname++;
+    }
+    for (;i<dim;i++)
+      hcol[i]= ++maxcol;
+  }
+  check_alloc(cname=(char**)malloc(sizeof(char*)*dim));
+  hname=names;
+  for (i=0;i<dim;i++) {
+    check_alloc(cname[i]=(char*)calloc((size_t)BINARY_NAME_SIZE,(size_t)1));
+    if ((hname != NULL) && (*hname != '\0')) {
+      if ((comma=strchr(hname,',')) != NULL)
+        *comma='\0';
+      strncpy(cname[i],hname,(size_t)BINARY_NAME_SIZE-1);
+      hname=(comma != NULL) ? comma+1 : hname+strlen(hname);
+    }
+    else
+      sprintf(cname[i],"%u",hcol[i]);
+  }
+
+  write_binary_columns(outfile,series,dim,length,cname);
+  if (verbosity&VER_INPUT)
+    fprintf(stderr,"Wrote %lu rows of %u column(s) to %s\n",length,dim,
+            outfile);
+
+  /*Freeing all allocated arrays*/
+  for (i=0;i<dim;i++)
+    free(cname[i]);
+  free(cname);
+  free(hcol);
+  free_multi_series(series,dim);
+  if (outfile != NULL) free(outfile);
+  if (infile != NULL) free(infile);
+  if (columns != NULL) free(columns);
+  if (names != NULL) free(names);
+
+  return 0;
+}